@@ -0,0 +1,220 @@
+#include "block_allocator.h"
+#include "fixed_block_allocator.h"
+#include "node_pool_resource.h"
+#include "predefined_block_allocator.h"
+#include "static_predefined_block_allocator.h"
+#include "stl_allocator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <thread>
+#include <vector>
+
+using namespace salloc;
+
+namespace
+{
+
+constexpr size_t thread_count = 4;
+constexpr size_t iteration_count = 10'000'000;
+
+constexpr size_t churn_block_count = 10'000;
+constexpr size_t churn_round_count = 200;
+
+constexpr size_t map_entry_count = 1'000'000;
+constexpr size_t map_lookup_count = 1'000'000;
+
+// Per-connection counter, 24 bytes
+struct Counter
+{
+    std::atomic<uint64_t> hits;
+    uint64_t bytes;
+    uint64_t flags;
+};
+
+// Every thread hammers its own counter. Counters sharing a cache line fall into false sharing
+double RunContention(BlockPlacement placement)
+{
+    BlockAllocator ba;
+
+    Counter* counters[thread_count];
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        counters[i] = new (ba.Allocate(sizeof(Counter), placement)) Counter{};
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        threads.emplace_back([counter = counters[i]]() {
+            for (size_t j = 0; j < iteration_count; ++j)
+            {
+                counter->hits.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        ba.Free(counters[i], sizeof(Counter), placement);
+    }
+
+    double seconds = std::chrono::duration<double>(end - begin).count();
+    return thread_count * iteration_count / seconds / 1e6;
+}
+
+// Allocates a batch of blocks and frees them in an interleaved order, repeatedly.
+// Returns nanoseconds per allocate/free pair
+template <typename AllocatorType>
+double RunChurn(AllocatorType& allocator, size_t (*sizeOf)(size_t i))
+{
+    std::vector<void*> blocks(churn_block_count);
+
+    auto begin = std::chrono::steady_clock::now();
+
+    for (size_t round = 0; round < churn_round_count; ++round)
+    {
+        for (size_t i = 0; i < churn_block_count; ++i)
+        {
+            blocks[i] = allocator.Allocate(sizeOf(i));
+        }
+
+        // Even blocks first, then odd ones
+        for (size_t i = 0; i < churn_block_count; i += 2)
+        {
+            allocator.Free(blocks[i], sizeOf(i));
+        }
+        for (size_t i = 1; i < churn_block_count; i += 2)
+        {
+            allocator.Free(blocks[i], sizeOf(i));
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    double nanoseconds = std::chrono::duration<double, std::nano>(end - begin).count();
+    return nanoseconds / (churn_block_count * churn_round_count);
+}
+
+struct MapTimes
+{
+    double insert;
+    double lookup;
+    double iterate;
+};
+
+// Fills a map in key order while allocating an unrelated 48 byte record per entry from the same allocator,
+// then times random lookups and a full in-order iteration. Times are in milliseconds
+template <typename AllocatorType>
+MapTimes RunMap(AllocatorType& allocator)
+{
+    using Map = std::map<uint64_t, uint64_t, std::less<uint64_t>, StlAllocator<std::pair<const uint64_t, uint64_t>, AllocatorType>>;
+
+    MapTimes times;
+    std::vector<void*> records(map_entry_count);
+
+    {
+        Map map(allocator);
+
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < map_entry_count; ++i)
+        {
+            map.emplace(i, i);
+            records[i] = allocator.Allocate(48);
+        }
+        auto end = std::chrono::steady_clock::now();
+        times.insert = std::chrono::duration<double, std::milli>(end - begin).count();
+
+        uint64_t sum = 0;
+        uint64_t key = 1;
+
+        begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < map_lookup_count; ++i)
+        {
+            key = key * 6364136223846793005ull + 1442695040888963407ull;
+            sum += map.find((key >> 33) % map_entry_count)->second;
+        }
+        end = std::chrono::steady_clock::now();
+        times.lookup = std::chrono::duration<double, std::milli>(end - begin).count();
+
+        begin = std::chrono::steady_clock::now();
+        for (const auto& pair : map)
+        {
+            sum += pair.second;
+        }
+        end = std::chrono::steady_clock::now();
+        times.iterate = std::chrono::duration<double, std::milli>(end - begin).count();
+
+        // Keep the sums alive
+        if (sum == 0)
+        {
+            std::printf(" ");
+        }
+    }
+
+    for (void* record : records)
+    {
+        allocator.Free(record, 48);
+    }
+
+    return times;
+}
+
+} // namespace
+
+int main()
+{
+#if defined(SALLOC_HARDENED)
+    std::printf("Hardened: yes\n\n");
+#else
+    std::printf("Hardened: no\n\n");
+#endif
+
+    std::printf("Churn: %zu rounds x %zu blocks\n", churn_round_count, churn_block_count);
+    {
+        FixedBlockAllocator<32> fba;
+        std::printf("  FixedBlockAllocator            %6.2f ns/op\n", RunChurn(fba, [](size_t) -> size_t { return 32; }));
+
+        PredefinedBlockAllocator pba;
+        std::printf("  PredefinedBlockAllocator       %6.2f ns/op\n", RunChurn(pba, [](size_t i) -> size_t { return 16 + i % 512; }));
+
+        StaticPredefinedBlockAllocator<16, 32, 64, 96, 128, 160, 192, 224, 256, 320, 384, 448, 512, 640> spba;
+        std::printf("  StaticPredefinedBlockAllocator %6.2f ns/op\n", RunChurn(spba, [](size_t i) -> size_t { return 16 + i % 512; }));
+
+        BlockAllocator ba;
+        std::printf("  BlockAllocator                 %6.2f ns/op\n", RunChurn(ba, [](size_t i) -> size_t { return 1 + i % 1024; }));
+    }
+
+    std::printf("\nstd::map with interleaved records: %zu entries, %zu lookups\n", map_entry_count, map_lookup_count);
+    {
+        BlockAllocator ba;
+        MapTimes times = RunMap(ba);
+        std::printf(
+            "  BlockAllocator    insert %7.2f ms, lookup %7.2f ms, iterate %6.2f ms\n", times.insert, times.lookup, times.iterate
+        );
+
+        NodePoolResource npr;
+        times = RunMap(npr);
+        std::printf(
+            "  NodePoolResource  insert %7.2f ms, lookup %7.2f ms, iterate %6.2f ms\n", times.insert, times.lookup, times.iterate
+        );
+    }
+
+    std::printf("\nContention: %zu threads x %zu increments\n", thread_count, iteration_count);
+    std::printf("  packed              %8.1f Mops/s\n", RunContention(BlockPlacement::packed));
+    std::printf("  cache_line_aligned  %8.1f Mops/s\n", RunContention(BlockPlacement::cache_line_aligned));
+    std::printf("  cache_line_isolated %8.1f Mops/s\n", RunContention(BlockPlacement::cache_line_isolated));
+
+    return 0;
+}
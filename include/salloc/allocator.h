@@ -1,26 +1,113 @@
 #pragma once
 
 #include <assert.h>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <utility>
 
+#include "instrumentation.h"
+#include "sanitizer.h"
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
 #define sallocNotUsed(x) ((void)(x));
 
+// Realtime thread checks are debug assertions, enabled with asserts or with SALLOC_REALTIME_CHECKS
+#if !defined(NDEBUG) && !defined(SALLOC_REALTIME_CHECKS)
+#define SALLOC_REALTIME_CHECKS 1
+#endif
+
 namespace salloc
 {
 
+using RealtimeViolationHandler = void (*)(size_t size);
+
+// Threads tagged realtime must not reach the upstream allocator.
+// Upstream calls on them go to the violation handler, or fire an assertion when there's none.
+// Without SALLOC_REALTIME_CHECKS the check compiles to nothing
+inline thread_local bool realtimeThread = false;
+inline std::atomic<RealtimeViolationHandler> realtimeViolationHandler{ nullptr };
+
+inline void SetRealtimeThread(bool realtime)
+{
+    realtimeThread = realtime;
+}
+
+inline bool IsRealtimeThread()
+{
+    return realtimeThread;
+}
+
+inline void SetRealtimeViolationHandler(RealtimeViolationHandler handler)
+{
+    realtimeViolationHandler.store(handler, std::memory_order_release);
+}
+
+inline void CheckRealtimeThread(size_t size)
+{
+#if defined(SALLOC_REALTIME_CHECKS)
+    if (realtimeThread)
+    {
+        RealtimeViolationHandler handler = realtimeViolationHandler.load(std::memory_order_acquire);
+        if (handler)
+        {
+            handler(size);
+        }
+        else
+        {
+            assert(false && "Upstream allocator called on a realtime thread");
+        }
+    }
+#else
+    sallocNotUsed(size);
+#endif
+}
+
 // Default upstream allocation function
 inline void* Alloc(size_t size)
 {
+    CheckRealtimeThread(size);
+    sallocInstrumentScope(InstrumentEvent::upstream_alloc, 0);
     return std::malloc(size);
 }
 
 inline void Free(void* mem)
 {
+    CheckRealtimeThread(0);
     std::free(mem);
 }
 
+inline void* Realloc(void* mem, size_t size)
+{
+    CheckRealtimeThread(size);
+    return std::realloc(mem, size);
+}
+
+// Size must be a multiple of alignment
+inline void* AlignedAlloc(size_t size, size_t alignment)
+{
+    CheckRealtimeThread(size);
+    sallocInstrumentScope(InstrumentEvent::upstream_alloc, 0);
+#if defined(_WIN32)
+    return _aligned_malloc(size, alignment);
+#else
+    return std::aligned_alloc(alignment, size);
+#endif
+}
+
+inline void AlignedFree(void* mem)
+{
+    CheckRealtimeThread(0);
+#if defined(_WIN32)
+    _aligned_free(mem);
+#else
+    std::free(mem);
+#endif
+}
+
 struct Block
 {
     Block* next;
@@ -34,6 +121,13 @@ struct Chunk
     Chunk* next;
 };
 
+// Number of free blocks of a size to have ready ahead of time
+struct Reservation
+{
+    size_t size;
+    size_t count;
+};
+
 class Allocator
 {
 public:
@@ -44,6 +138,10 @@ public:
     virtual void Free(void* p, size_t size) = 0;
     virtual void Clear() = 0;
 
+    // Resize the allocation p while preserving its contents.
+    // Falls back to allocate, copy and free. Allocators override this with in-place fast paths
+    virtual void* Reallocate(void* p, size_t oldSize, size_t newSize);
+
     template <typename T, typename... Args>
     T* New(Args&&... args)
     {
@@ -58,4 +156,28 @@ public:
     }
 };
 
+inline void* Allocator::Reallocate(void* p, size_t oldSize, size_t newSize)
+{
+    if (p == nullptr)
+    {
+        return Allocate(newSize);
+    }
+    if (newSize == 0)
+    {
+        Free(p, oldSize);
+        return nullptr;
+    }
+
+    void* mem = Allocate(newSize);
+    if (mem == nullptr)
+    {
+        return nullptr;
+    }
+
+    memcpy(mem, p, oldSize < newSize ? oldSize : newSize);
+    Free(p, oldSize);
+
+    return mem;
+}
+
 } // namespace salloc
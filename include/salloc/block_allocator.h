@@ -1,10 +1,30 @@
 #pragma once
 
 #include "allocator.h"
+#include "realtime.h"
+
+#if defined(SALLOC_HARDENED)
+#include "hardening.h"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <span>
+#include <thread>
 
 namespace salloc
 {
 
+// Placement of blocks handed out to different threads
+enum class BlockPlacement
+{
+    packed,              // Blocks are packed by 8 bytes
+    cache_line_aligned,  // Blocks are rounded up to whole cache lines
+    cache_line_isolated, // Same as cache_line_aligned, plus an empty cache line between consecutive blocks
+};
+
 class BlockAllocator : public Allocator
 {
 public:
@@ -12,7 +32,14 @@ public:
     static constexpr inline size_t block_unit = 8;
     static constexpr inline size_t block_size_count = max_block_size / block_unit;
 
+    static constexpr inline size_t cache_line_size = 64;
+    static constexpr inline size_t cache_line_block_size_count = max_block_size / cache_line_size;
+
     BlockAllocator(size_t initialChunkSize = 16 * 1024);
+
+    // Realtime mode, chunks are carved from the budget and the upstream allocator is never called.
+    // Allocations fail with nullptr once the budget runs out, and Clear() keeps the chunks for reuse
+    BlockAllocator(RealtimeBudget& budget, size_t initialChunkSize = 16 * 1024, ExhaustionHandler onExhausted = nullptr);
     ~BlockAllocator();
 
     virtual void* Allocate(size_t size) override;
@@ -20,18 +47,83 @@ public:
     virtual void Clear() override;
     void Clear(size_t initialChunkSize);
 
+    virtual void* Reallocate(void* p, size_t oldSize, size_t newSize) override;
+
+    // Allocations for objects written by different threads, which must not share a cache line
+    void* Allocate(size_t size, BlockPlacement placement);
+    void Free(void* p, size_t size, BlockPlacement placement);
+
+    // Build free blocks ahead of time, so the first allocations of a size class don't create chunks
+    void Reserve(size_t size, size_t count);
+    void Prewarm(std::span<const Reservation> profile);
+
+    // Replenish() tops up every size class whose free block count dropped below its watermark
+    void SetWatermark(size_t size, size_t count);
+    void Replenish();
+
+    // Optional maintenance thread that prepares chunks for size classes running low on free blocks.
+    // A prepared chunk waits in a per-class handoff slot, and the allocating thread only swaps it in once the class runs dry.
+    // Clear may run while the thread is active, it waits for the current pass and discards the prepared chunks
+    void StartBackgroundRefill(std::chrono::microseconds interval = std::chrono::microseconds(100));
+    void StopBackgroundRefill();
+    bool IsChunkReady(size_t size) const;
+
+    // Blocks until a chunk is prepared for the size class, or the refill thread stops
+    void WaitForChunk(size_t size);
+
     size_t GetBlockCount() const;
     size_t GetChunkCount() const;
 
     size_t GetChunkSize(size_t size) const;
+    size_t GetFreeCount(size_t size) const;
 
 private:
+    static size_t GetLineStride(size_t size, BlockPlacement placement);
+    static size_t GetBlockSizeIndex(size_t size);
+
+    // Adds a chunk of at least minCapacity blocks to the free list of the size class
+    bool CreateChunk(size_t index, size_t minCapacity);
+    Block* LinkBlocks(Block* blocks, size_t blockSize, size_t capacity, Block* tail);
+    void RecycleChunks();
+    void SpliceChunk(size_t index, Chunk* chunk);
+    void DiscardReadyChunks();
+
+    void RefillLoop(std::chrono::microseconds interval);
+    Chunk* PrepareChunk(size_t index, size_t chunkSize);
+
     size_t blockCount;
     size_t chunkCount;
 
     size_t chunkSizes[block_size_count];
     Chunk* chunks;
     Block* freeList[block_size_count];
+
+    // Written by the owning thread only, read by the refill thread
+    std::atomic<size_t> freeCounts[block_size_count];
+    std::atomic<size_t> watermarks[block_size_count];
+    // Size of the last chunk of each size class, zero until the class is used
+    std::atomic<size_t> lastChunkSizes[block_size_count];
+
+    // Chunks prepared by the refill thread, blocks already linked and poisoned
+    std::atomic<Chunk*> readyChunks[block_size_count];
+
+    std::thread refillThread;
+    std::mutex refillMutex;
+    std::condition_variable refillSignal;
+    std::condition_variable chunkSignal;
+    bool refillRunning;
+
+    // Cache line sized blocks, indexed by [placement - 1][size class]
+    size_t initialChunkSize;
+    Chunk* lineChunks[2];
+    Block* lineFreeList[2][cache_line_block_size_count];
+
+    RealtimeBudget* budget;
+    ExhaustionHandler onExhausted;
+
+#if defined(SALLOC_HARDENED)
+    FreeListGuard guard;
+#endif
 };
 
 inline size_t BlockAllocator::GetBlockCount() const
@@ -44,4 +136,10 @@ inline size_t BlockAllocator::GetChunkCount() const
     return chunkCount;
 }
 
+inline size_t BlockAllocator::GetBlockSizeIndex(size_t size)
+{
+    assert(0 < size && size <= max_block_size);
+    return (size - 1) / block_unit;
+}
+
 } // namespace salloc
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "allocator.h"
+
+#include <cstdint>
+
+namespace salloc
+{
+
+struct BuddyStats
+{
+    size_t blockSize;
+    size_t freeCount;
+    size_t usedCount;
+};
+
+// Buddy allocator handing out power of two blocks, from minBlockSize up to the whole region.
+// Blocks split in halves on allocation and merge back with their buddy on free.
+// Free lists and split state live in bitmaps and index links outside the managed memory, which is never written
+class BuddyAllocator : public Allocator
+{
+public:
+    static constexpr inline size_t max_order_count = 32;
+
+    // Region size is rounded up to a power of two
+    BuddyAllocator(size_t regionSize = 64 * 1024 * 1024, size_t minBlockSize = 4 * 1024);
+
+    // Manages the given memory, whose size must be minBlockSize times a power of two
+    BuddyAllocator(void* memory, size_t size, size_t minBlockSize = 4 * 1024);
+    ~BuddyAllocator();
+
+    BuddyAllocator(const BuddyAllocator&) = delete;
+    BuddyAllocator& operator=(const BuddyAllocator&) = delete;
+
+    // Returns nullptr when no block of the rounded size is free
+    virtual void* Allocate(size_t size) override;
+    virtual void Free(void* p, size_t size) override;
+    virtual void Clear() override;
+
+    // Stays in place while the order doesn't change
+    virtual void* Reallocate(void* p, size_t oldSize, size_t newSize) override;
+
+    // Order 0 holds blocks of minBlockSize
+    size_t GetOrder(size_t size) const;
+    size_t GetOrderCount() const;
+    BuddyStats GetStats(size_t order) const;
+
+    size_t GetRegionSize() const;
+    size_t GetFreeSize() const;
+    size_t GetLargestFreeBlock() const;
+
+    // One minus the largest free block over the total free size, zero when free memory is in one piece
+    double GetFragmentation() const;
+
+private:
+    // Nodes are numbered like a binary heap, the root is 1 so 0 ends free lists
+    struct Link
+    {
+        uint32_t next;
+        uint32_t prev;
+    };
+
+    void Init(size_t minBlockSize);
+
+    size_t GetLevel(size_t order) const;
+    size_t GetNode(const void* p, size_t order) const;
+    char* GetBlock(size_t node, size_t order) const;
+
+    static bool GetBit(const uint64_t* bits, size_t node);
+    static void SetBit(uint64_t* bits, size_t node, bool value);
+
+    void Push(size_t order, size_t node);
+    void Remove(size_t order, size_t node);
+
+    bool owned;
+    char* memory;
+    size_t regionSize;
+    size_t minBlockSize;
+    size_t orderCount;
+
+    size_t freeSize;
+
+    Link* links;
+    uint64_t* freeBits;
+    uint64_t* splitBits;
+
+    uint32_t freeLists[max_order_count];
+    size_t freeCounts[max_order_count];
+    size_t usedCounts[max_order_count];
+};
+
+inline size_t BuddyAllocator::GetOrderCount() const
+{
+    return orderCount;
+}
+
+inline size_t BuddyAllocator::GetRegionSize() const
+{
+    return regionSize;
+}
+
+inline size_t BuddyAllocator::GetFreeSize() const
+{
+    return freeSize;
+}
+
+inline size_t BuddyAllocator::GetLevel(size_t order) const
+{
+    return orderCount - 1 - order;
+}
+
+inline bool BuddyAllocator::GetBit(const uint64_t* bits, size_t node)
+{
+    return (bits[node / 64] >> (node % 64)) & 1;
+}
+
+inline void BuddyAllocator::SetBit(uint64_t* bits, size_t node, bool value)
+{
+    if (value)
+    {
+        bits[node / 64] |= uint64_t(1) << (node % 64);
+    }
+    else
+    {
+        bits[node / 64] &= ~(uint64_t(1) << (node % 64));
+    }
+}
+
+} // namespace salloc
@@ -0,0 +1,311 @@
+#pragma once
+
+#include "allocator.h"
+
+namespace salloc
+{
+
+// Stack allocator with two stacks growing towards each other in one buffer,
+// e.g. long lived allocations from the bottom and transient ones from the top, sharing a single budget.
+// Each end keeps its own entries and must nest its own allocate/free pairs.
+// The Allocator interface works on the bottom end
+template <size_t stackSize = 100 * 1024, size_t maxStackEntries = 32>
+class DoubleEndedStackAllocator : public Allocator
+{
+public:
+    DoubleEndedStackAllocator();
+    ~DoubleEndedStackAllocator();
+
+    virtual void* Allocate(size_t size) override;
+    virtual void Free(void* p, size_t size) override;
+    virtual void Clear() override;
+
+    // Extends or shrinks the top allocation of the bottom end in place
+    virtual void* Reallocate(void* p, size_t oldSize, size_t newSize) override;
+
+    void* AllocateBottom(size_t size);
+    void FreeBottom(void* p, size_t size);
+    void* AllocateTop(size_t size);
+    void FreeTop(void* p, size_t size);
+
+    // Drops every allocation of one end, the other end is untouched
+    void ClearBottom();
+    void ClearTop();
+
+    size_t GetBottomAllocation() const;
+    size_t GetTopAllocation() const;
+
+    // Both ends together
+    size_t GetAllocation() const;
+    size_t GetMaxAllocation() const;
+
+private:
+    struct StackEntry
+    {
+        char* data;
+        size_t size;
+        bool mallocUsed;
+    };
+
+    struct StackEnd
+    {
+        // Bytes used from this end of the buffer
+        size_t index;
+        size_t allocation;
+
+        StackEntry entries[maxStackEntries];
+        size_t entryCount;
+    };
+
+    void* Push(StackEnd& end, size_t size, bool fromTop);
+    void Pop(StackEnd& end, void* p, size_t size);
+    void Reset(StackEnd& end, bool fromTop);
+
+    char stack[stackSize];
+
+    StackEnd bottom;
+    StackEnd top;
+
+    size_t maxAllocation;
+};
+
+template <size_t stackSize, size_t maxStackEntries>
+DoubleEndedStackAllocator<stackSize, maxStackEntries>::DoubleEndedStackAllocator()
+    : maxAllocation{ 0 }
+{
+    bottom.index = 0;
+    bottom.allocation = 0;
+    bottom.entryCount = 0;
+
+    top.index = 0;
+    top.allocation = 0;
+    top.entryCount = 0;
+
+    sallocPoison(stack, stackSize);
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+DoubleEndedStackAllocator<stackSize, maxStackEntries>::~DoubleEndedStackAllocator()
+{
+    assert(bottom.entryCount == 0 && top.entryCount == 0);
+
+    // The stack memory is handed back to its owner
+    sallocUnpoison(stack, stackSize);
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void* DoubleEndedStackAllocator<stackSize, maxStackEntries>::Allocate(size_t size)
+{
+    return Push(bottom, size, false);
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void DoubleEndedStackAllocator<stackSize, maxStackEntries>::Free(void* p, size_t size)
+{
+    Pop(bottom, p, size);
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void DoubleEndedStackAllocator<stackSize, maxStackEntries>::Clear()
+{
+    Reset(bottom, false);
+    Reset(top, true);
+
+    maxAllocation = 0;
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void* DoubleEndedStackAllocator<stackSize, maxStackEntries>::Reallocate(void* p, size_t oldSize, size_t newSize)
+{
+    if (p == nullptr || newSize == 0)
+    {
+        return Allocator::Reallocate(p, oldSize, newSize);
+    }
+
+    assert(bottom.entryCount > 0);
+
+    // Only the top allocation can be resized
+    StackEntry* entry = bottom.entries + (bottom.entryCount - 1);
+    assert(entry->data == p);
+    assert(entry->size == oldSize);
+
+    if (entry->mallocUsed)
+    {
+        // Leaves the allocation as it is on failure
+        char* data = (char*)salloc::Realloc(p, newSize);
+        if (data == nullptr)
+        {
+            return nullptr;
+        }
+
+        entry->data = data;
+    }
+    else if (bottom.index - oldSize + newSize + top.index <= stackSize)
+    {
+        bottom.index = bottom.index - oldSize + newSize;
+        sallocPoison(p, oldSize + redzone_size);
+        sallocUnpoison(p, newSize);
+    }
+    else
+    {
+        // Move out to the upstream allocator
+        char* data = (char*)salloc::Alloc(newSize);
+        if (data == nullptr)
+        {
+            return nullptr;
+        }
+
+        entry->data = data;
+        entry->mallocUsed = true;
+        memcpy(entry->data, p, oldSize);
+        bottom.index -= oldSize + redzone_size;
+        sallocPoison(p, oldSize);
+    }
+
+    entry->size = newSize;
+
+    bottom.allocation = bottom.allocation - oldSize + newSize;
+    if (GetAllocation() > maxAllocation)
+    {
+        maxAllocation = GetAllocation();
+    }
+
+    return entry->data;
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void* DoubleEndedStackAllocator<stackSize, maxStackEntries>::AllocateBottom(size_t size)
+{
+    return Push(bottom, size, false);
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void DoubleEndedStackAllocator<stackSize, maxStackEntries>::FreeBottom(void* p, size_t size)
+{
+    Pop(bottom, p, size);
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void* DoubleEndedStackAllocator<stackSize, maxStackEntries>::AllocateTop(size_t size)
+{
+    return Push(top, size, true);
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void DoubleEndedStackAllocator<stackSize, maxStackEntries>::FreeTop(void* p, size_t size)
+{
+    Pop(top, p, size);
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void DoubleEndedStackAllocator<stackSize, maxStackEntries>::ClearBottom()
+{
+    Reset(bottom, false);
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void DoubleEndedStackAllocator<stackSize, maxStackEntries>::ClearTop()
+{
+    Reset(top, true);
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+size_t DoubleEndedStackAllocator<stackSize, maxStackEntries>::GetBottomAllocation() const
+{
+    return bottom.allocation;
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+size_t DoubleEndedStackAllocator<stackSize, maxStackEntries>::GetTopAllocation() const
+{
+    return top.allocation;
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+size_t DoubleEndedStackAllocator<stackSize, maxStackEntries>::GetAllocation() const
+{
+    return bottom.allocation + top.allocation;
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+size_t DoubleEndedStackAllocator<stackSize, maxStackEntries>::GetMaxAllocation() const
+{
+    return maxAllocation;
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void* DoubleEndedStackAllocator<stackSize, maxStackEntries>::Push(StackEnd& end, size_t size, bool fromTop)
+{
+    assert(end.entryCount < maxStackEntries && "Increase the maxStackEntries");
+
+    StackEntry* entry = end.entries + end.entryCount;
+    entry->size = size;
+
+    if (bottom.index + top.index + size + redzone_size > stackSize)
+    {
+        entry->data = (char*)salloc::Alloc(size);
+        entry->mallocUsed = true;
+    }
+    else
+    {
+        // The redzone after the allocation stays poisoned, on both ends
+        end.index += size + redzone_size;
+        entry->data = fromTop ? stack + stackSize - end.index : stack + end.index - size - redzone_size;
+        entry->mallocUsed = false;
+        sallocUnpoison(entry->data, size);
+    }
+
+    end.allocation += size;
+    if (GetAllocation() > maxAllocation)
+    {
+        maxAllocation = GetAllocation();
+    }
+
+    ++end.entryCount;
+
+    return entry->data;
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void DoubleEndedStackAllocator<stackSize, maxStackEntries>::Pop(StackEnd& end, void* p, size_t size)
+{
+    sallocNotUsed(size);
+    assert(end.entryCount > 0);
+
+    StackEntry* entry = end.entries + (end.entryCount - 1);
+    assert(entry->data == p);
+    assert(entry->size == size);
+
+    if (entry->mallocUsed)
+    {
+        salloc::Free(p);
+    }
+    else
+    {
+        end.index -= entry->size + redzone_size;
+        sallocPoison(p, entry->size);
+    }
+
+    end.allocation -= entry->size;
+    --end.entryCount;
+}
+
+template <size_t stackSize, size_t maxStackEntries>
+void DoubleEndedStackAllocator<stackSize, maxStackEntries>::Reset(StackEnd& end, bool fromTop)
+{
+    for (size_t i = 0; i < end.entryCount; ++i)
+    {
+        if (end.entries[i].mallocUsed)
+        {
+            salloc::Free(end.entries[i].data);
+        }
+    }
+
+    sallocPoison(fromTop ? stack + stackSize - end.index : stack, end.index);
+
+    end.index = 0;
+    end.allocation = 0;
+    end.entryCount = 0;
+}
+
+} // namespace salloc
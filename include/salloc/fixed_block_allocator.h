@@ -1,6 +1,11 @@
 #pragma once
 
 #include "allocator.h"
+#include "realtime.h"
+
+#if defined(SALLOC_HARDENED)
+#include "hardening.h"
+#endif
 
 namespace salloc
 {
@@ -10,31 +15,58 @@ class FixedBlockAllocator : public Allocator
 {
 public:
     FixedBlockAllocator(size_t initialBlockCapacity = 64);
+
+    // Realtime mode, chunks are carved from the budget and the upstream allocator is never called.
+    // Allocations fail with nullptr once the budget runs out, and Clear() keeps the chunks for reuse
+    FixedBlockAllocator(RealtimeBudget& budget, size_t initialBlockCapacity = 64, ExhaustionHandler onExhausted = nullptr);
     ~FixedBlockAllocator();
 
     void* Allocate(size_t size = blockSize) override;
     void Free(void* p, size_t size = blockSize) override;
     void Clear() override;
 
+    void* Reallocate(void* p, size_t oldSize, size_t newSize) override;
+
     size_t GetChunkCount() const;
     size_t GetBlockCount() const;
 
+    const Chunk* GetChunks() const;
+
 private:
+    Block* LinkBlocks(Block* blocks, size_t capacity, Block* tail);
+
     size_t blockCapacity;
     size_t chunkCount;
     size_t blockCount;
     Chunk* chunks;
     Block* freeList;
+
+    RealtimeBudget* budget;
+    ExhaustionHandler onExhausted;
+
+#if defined(SALLOC_HARDENED)
+    FreeListGuard guard;
+#endif
 };
 
 template <size_t blockSize>
 FixedBlockAllocator<blockSize>::FixedBlockAllocator(size_t initialBlockCapacity)
     : blockCapacity{ initialBlockCapacity }
-    , blockCount{ 0 }
     , chunkCount{ 0 }
+    , blockCount{ 0 }
     , chunks{ nullptr }
     , freeList{ nullptr }
+    , budget{ nullptr }
+    , onExhausted{ nullptr }
+{
+}
+
+template <size_t blockSize>
+FixedBlockAllocator<blockSize>::FixedBlockAllocator(RealtimeBudget& budget, size_t initialBlockCapacity, ExhaustionHandler onExhausted)
+    : FixedBlockAllocator(initialBlockCapacity)
 {
+    this->budget = &budget;
+    this->onExhausted = onExhausted;
 }
 
 template <size_t blockSize>
@@ -50,40 +82,62 @@ void* FixedBlockAllocator<blockSize>::Allocate(size_t size)
 
     if (size > blockSize)
     {
+        if (budget)
+        {
+            return ReportExhaustion(onExhausted, size);
+        }
         return salloc::Alloc(size);
     }
 
     if (freeList == nullptr)
     {
-        assert(blockCount == 0 || blockCapacity == blockCount / chunkCount);
+        sallocInstrumentScope(InstrumentEvent::refill, blockSize);
 
         blockCapacity += blockCapacity / 2;
-        Block* blocks = (Block*)salloc::Alloc(blockCapacity * blockSize);
-        memset(blocks, 0, blockCapacity * blockSize);
 
-        // Build a linked list for the free list.
-        for (size_t i = 0; i < blockCapacity - 1; ++i)
+        Chunk* newChunk;
+        if (budget)
         {
-            Block* block = (Block*)((char*)blocks + blockSize * i);
-            Block* next = (Block*)((char*)blocks + blockSize * (i + 1));
-            block->next = next;
+            newChunk = budget->AllocateChunk(blockSize, blockCapacity, 1);
+            if (newChunk == nullptr)
+            {
+                return ReportExhaustion(onExhausted, size);
+            }
         }
-        Block* last = (Block*)((char*)blocks + blockSize * (blockCapacity - 1));
-        last->next = nullptr;
+        else
+        {
+            newChunk = (Chunk*)salloc::Alloc(sizeof(Chunk));
+            newChunk->capacity = blockCapacity;
+            newChunk->blockSize = blockSize;
+            newChunk->blocks = (Block*)salloc::Alloc(blockCapacity * blockSize);
+        }
+
+        Block* blocks = newChunk->blocks;
+        memset(blocks, 0, newChunk->capacity * blockSize);
+
+        Block* head = LinkBlocks(blocks, newChunk->capacity, nullptr);
+
+        // Free blocks stay poisoned until allocated
+        sallocPoison(blocks, newChunk->capacity * blockSize);
 
-        Chunk* newChunk = (Chunk*)salloc::Alloc(sizeof(Chunk));
-        newChunk->capacity = blockCapacity;
-        newChunk->blockSize = blockSize;
-        newChunk->blocks = blocks;
         newChunk->next = chunks;
         chunks = newChunk;
         ++chunkCount;
 
-        freeList = newChunk->blocks;
+        freeList = head;
+    }
+    else
+    {
+        sallocInstrumentCount(InstrumentEvent::free_list_pop, blockSize);
     }
 
-    void* block = freeList;
-    freeList = freeList->next;
+    Block* block = freeList;
+    sallocUnpoison(block, blockSize);
+#if defined(SALLOC_HARDENED)
+    freeList = guard.Pop(block, blockSize);
+#else
+    freeList = block->next;
+#endif
     ++blockCount;
 
     return block;
@@ -96,7 +150,11 @@ void FixedBlockAllocator<blockSize>::Free(void* p, size_t size)
 
     if (size > blockSize)
     {
-        salloc::Free(p);
+        // Never handed out in realtime mode
+        if (budget == nullptr)
+        {
+            salloc::Free(p);
+        }
         return;
     }
 
@@ -119,7 +177,12 @@ void FixedBlockAllocator<blockSize>::Free(void* p, size_t size)
 #endif
 
     Block* block = (Block*)p;
+#if defined(SALLOC_HARDENED)
+    guard.Push(block, freeList, blockSize);
+#else
     block->next = freeList;
+#endif
+    sallocPoison(block, blockSize);
     freeList = block;
     --blockCount;
 }
@@ -127,17 +190,88 @@ void FixedBlockAllocator<blockSize>::Free(void* p, size_t size)
 template <size_t blockSize>
 void FixedBlockAllocator<blockSize>::Clear()
 {
+    sallocInstrumentScope(InstrumentEvent::clear, 0);
+
+    if (budget)
+    {
+        // Budget memory is never given back, so every block goes back on the free list instead
+        freeList = nullptr;
+        blockCount = 0;
+
+#if defined(SALLOC_HARDENED)
+        guard.Clear();
+#endif
+
+        for (Chunk* chunk = chunks; chunk; chunk = chunk->next)
+        {
+            sallocUnpoison(chunk->blocks, chunk->capacity * blockSize);
+            freeList = LinkBlocks(chunk->blocks, chunk->capacity, freeList);
+            sallocPoison(chunk->blocks, chunk->capacity * blockSize);
+        }
+
+        return;
+    }
+
     Chunk* chunk = chunks;
     while (chunk)
     {
         Chunk* c0 = chunk;
         chunk = c0->next;
+        sallocUnpoison(c0->blocks, c0->capacity * c0->blockSize);
         salloc::Free(c0->blocks);
         salloc::Free(c0);
     }
 
+    chunkCount = 0;
+    blockCount = 0;
     chunks = nullptr;
     freeList = nullptr;
+
+#if defined(SALLOC_HARDENED)
+    guard.Clear();
+#endif
+}
+
+template <size_t blockSize>
+Block* FixedBlockAllocator<blockSize>::LinkBlocks(Block* blocks, size_t capacity, Block* tail)
+{
+#if defined(SALLOC_HARDENED)
+    return guard.AddChunk(blocks, blockSize, capacity, tail);
+#else
+    // Build a linked list for the free list.
+    for (size_t i = 0; i < capacity - 1; ++i)
+    {
+        Block* block = (Block*)((char*)blocks + blockSize * i);
+        Block* next = (Block*)((char*)blocks + blockSize * (i + 1));
+        block->next = next;
+    }
+    Block* last = (Block*)((char*)blocks + blockSize * (capacity - 1));
+    last->next = tail;
+
+    return blocks;
+#endif
+}
+
+template <size_t blockSize>
+void* FixedBlockAllocator<blockSize>::Reallocate(void* p, size_t oldSize, size_t newSize)
+{
+    if (p == nullptr || newSize == 0)
+    {
+        return Allocator::Reallocate(p, oldSize, newSize);
+    }
+
+    if (oldSize > blockSize && newSize > blockSize)
+    {
+        return salloc::Realloc(p, newSize);
+    }
+
+    // Still fits in the block
+    if (oldSize <= blockSize && newSize <= blockSize)
+    {
+        return p;
+    }
+
+    return Allocator::Reallocate(p, oldSize, newSize);
 }
 
 template <size_t blockSize>
@@ -152,4 +286,10 @@ size_t FixedBlockAllocator<blockSize>::GetBlockCount() const
     return blockCount;
 }
 
+template <size_t blockSize>
+const Chunk* FixedBlockAllocator<blockSize>::GetChunks() const
+{
+    return chunks;
+}
+
 } // namespace salloc
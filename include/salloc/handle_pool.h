@@ -0,0 +1,274 @@
+#pragma once
+
+#include "allocator.h"
+
+#include <cstdint>
+
+namespace salloc
+{
+
+// 32-bit slot index plus the generation of the slot at the time the handle was created
+struct Handle
+{
+    uint32_t index;
+    uint32_t generation;
+
+    bool operator==(const Handle& other) const = default;
+};
+
+// Typed pool addressed by handles instead of pointers.
+// Objects are stored densely in chunks of chunkBlockCount slots, with the generations of a chunk kept in
+// a separate array after its objects. A generation is odd while its slot is live, so validating a handle is
+// a single compare, and a stale handle to a destroyed or reused slot is rejected.
+template <typename T, size_t chunkBlockCount = 1024>
+class HandlePool
+{
+public:
+    static_assert(chunkBlockCount >= 16 && (chunkBlockCount & (chunkBlockCount - 1)) == 0,
+                  "chunkBlockCount must be a power of two");
+
+    // Free slots hold the next free index, so every slot is aligned for it as well
+    static constexpr inline size_t block_alignment = alignof(T) < alignof(uint32_t) ? alignof(uint32_t) : alignof(T);
+    static constexpr inline size_t block_size =
+        ((sizeof(T) < sizeof(uint32_t) ? sizeof(uint32_t) : sizeof(T)) + block_alignment - 1) / block_alignment * block_alignment;
+
+    HandlePool();
+    ~HandlePool();
+
+    HandlePool(const HandlePool&) = delete;
+    HandlePool& operator=(const HandlePool&) = delete;
+
+    template <typename... Args>
+    Handle Create(Args&&... args);
+    void Destroy(Handle handle);
+
+    // Destroys every object. Chunks and their generations are kept, so handles from before the clear stay stale
+    void Clear();
+
+    bool IsValid(Handle handle) const;
+
+    // Returns nullptr for stale handles
+    T* Get(Handle handle) const;
+
+    // Visits live objects in memory order
+    template <typename Function>
+    void ForEach(Function&& function);
+
+    size_t GetCount() const;
+    size_t GetChunkCount() const;
+
+private:
+    static constexpr inline uint32_t invalid_index = UINT32_MAX;
+    static constexpr inline size_t cache_line_size = 64;
+
+    // Generations are placed on a fresh cache line after the objects
+    static constexpr inline size_t generations_offset =
+        (chunkBlockCount * block_size + cache_line_size - 1) / cache_line_size * cache_line_size;
+    static constexpr inline size_t chunk_size =
+        (generations_offset + chunkBlockCount * sizeof(uint32_t) + cache_line_size - 1) / cache_line_size * cache_line_size;
+
+    static uint32_t* GetGenerations(const Chunk* chunk);
+    T* GetObject(uint32_t index) const;
+
+    void AddChunk();
+
+    Chunk* chunks; // Chunk table indexed by index / chunkBlockCount
+    size_t chunkCount;
+    size_t chunkCapacity;
+
+    size_t count;
+    uint32_t freeList; // Free slots are linked by index
+};
+
+template <typename T, size_t chunkBlockCount>
+HandlePool<T, chunkBlockCount>::HandlePool()
+    : chunks{ nullptr }
+    , chunkCount{ 0 }
+    , chunkCapacity{ 0 }
+    , count{ 0 }
+    , freeList{ invalid_index }
+{
+}
+
+template <typename T, size_t chunkBlockCount>
+HandlePool<T, chunkBlockCount>::~HandlePool()
+{
+    Clear();
+
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        salloc::AlignedFree(chunks[i].blocks);
+    }
+    salloc::Free(chunks);
+}
+
+template <typename T, size_t chunkBlockCount>
+template <typename... Args>
+Handle HandlePool<T, chunkBlockCount>::Create(Args&&... args)
+{
+    if (freeList == invalid_index)
+    {
+        AddChunk();
+    }
+
+    uint32_t index = freeList;
+    Chunk* chunk = chunks + index / chunkBlockCount;
+    uint32_t& generation = GetGenerations(chunk)[index % chunkBlockCount];
+
+    T* object = GetObject(index);
+    freeList = *(uint32_t*)object;
+
+    new (object) T(std::forward<Args>(args)...);
+    ++generation;
+    ++count;
+
+    return Handle{ index, generation };
+}
+
+template <typename T, size_t chunkBlockCount>
+void HandlePool<T, chunkBlockCount>::Destroy(Handle handle)
+{
+    assert(IsValid(handle));
+
+    Chunk* chunk = chunks + handle.index / chunkBlockCount;
+    uint32_t& generation = GetGenerations(chunk)[handle.index % chunkBlockCount];
+
+    T* object = GetObject(handle.index);
+    object->~T();
+
+    *(uint32_t*)object = freeList;
+    freeList = handle.index;
+    ++generation;
+    --count;
+}
+
+template <typename T, size_t chunkBlockCount>
+void HandlePool<T, chunkBlockCount>::Clear()
+{
+    // Relink every slot in index order, live slots move on to an even generation
+    freeList = invalid_index;
+    for (size_t i = chunkCount; i > 0; --i)
+    {
+        Chunk* chunk = chunks + (i - 1);
+        uint32_t* generations = GetGenerations(chunk);
+        uint32_t base = uint32_t((i - 1) * chunkBlockCount);
+
+        for (size_t j = chunkBlockCount; j > 0; --j)
+        {
+            T* object = (T*)((char*)chunk->blocks + block_size * (j - 1));
+            if (generations[j - 1] & 1)
+            {
+                object->~T();
+                ++generations[j - 1];
+            }
+
+            *(uint32_t*)object = freeList;
+            freeList = base + uint32_t(j - 1);
+        }
+    }
+
+    count = 0;
+}
+
+template <typename T, size_t chunkBlockCount>
+bool HandlePool<T, chunkBlockCount>::IsValid(Handle handle) const
+{
+    size_t chunkIndex = handle.index / chunkBlockCount;
+    if (chunkIndex >= chunkCount)
+    {
+        return false;
+    }
+
+    return GetGenerations(chunks + chunkIndex)[handle.index % chunkBlockCount] == handle.generation &&
+           (handle.generation & 1) == 1;
+}
+
+template <typename T, size_t chunkBlockCount>
+T* HandlePool<T, chunkBlockCount>::Get(Handle handle) const
+{
+    return IsValid(handle) ? GetObject(handle.index) : nullptr;
+}
+
+template <typename T, size_t chunkBlockCount>
+template <typename Function>
+void HandlePool<T, chunkBlockCount>::ForEach(Function&& function)
+{
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        Chunk* chunk = chunks + i;
+        uint32_t* generations = GetGenerations(chunk);
+
+        for (size_t j = 0; j < chunkBlockCount; ++j)
+        {
+            if (generations[j] & 1)
+            {
+                function(*(T*)((char*)chunk->blocks + block_size * j));
+            }
+        }
+    }
+}
+
+template <typename T, size_t chunkBlockCount>
+size_t HandlePool<T, chunkBlockCount>::GetCount() const
+{
+    return count;
+}
+
+template <typename T, size_t chunkBlockCount>
+size_t HandlePool<T, chunkBlockCount>::GetChunkCount() const
+{
+    return chunkCount;
+}
+
+template <typename T, size_t chunkBlockCount>
+uint32_t* HandlePool<T, chunkBlockCount>::GetGenerations(const Chunk* chunk)
+{
+    return (uint32_t*)((char*)chunk->blocks + generations_offset);
+}
+
+template <typename T, size_t chunkBlockCount>
+T* HandlePool<T, chunkBlockCount>::GetObject(uint32_t index) const
+{
+    Chunk* chunk = chunks + index / chunkBlockCount;
+    return (T*)((char*)chunk->blocks + block_size * (index % chunkBlockCount));
+}
+
+template <typename T, size_t chunkBlockCount>
+void HandlePool<T, chunkBlockCount>::AddChunk()
+{
+    assert((chunkCount + 1) * chunkBlockCount <= invalid_index);
+
+    if (chunkCount == chunkCapacity)
+    {
+        // Grow the chunk table by half
+        Chunk* old = chunks;
+        chunkCapacity = chunkCapacity == 0 ? 4 : chunkCapacity + chunkCapacity / 2;
+        chunks = (Chunk*)salloc::Alloc(chunkCapacity * sizeof(Chunk));
+        if (old)
+        {
+            memcpy(chunks, old, chunkCount * sizeof(Chunk));
+            salloc::Free(old);
+        }
+    }
+
+    Chunk* chunk = chunks + chunkCount;
+    chunk->capacity = chunkBlockCount;
+    chunk->blockSize = block_size;
+    chunk->blocks = (Block*)salloc::AlignedAlloc(chunk_size, cache_line_size);
+    chunk->next = nullptr;
+
+    memset(GetGenerations(chunk), 0, chunkBlockCount * sizeof(uint32_t));
+
+    // Build a linked list of slot indices for the free list.
+    uint32_t base = uint32_t(chunkCount * chunkBlockCount);
+    for (uint32_t i = 0; i < chunkBlockCount - 1; ++i)
+    {
+        *(uint32_t*)((char*)chunk->blocks + block_size * i) = base + i + 1;
+    }
+    *(uint32_t*)((char*)chunk->blocks + block_size * (chunkBlockCount - 1)) = freeList;
+
+    freeList = base;
+    ++chunkCount;
+}
+
+} // namespace salloc
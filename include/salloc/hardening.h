@@ -0,0 +1,71 @@
+#pragma once
+
+#include "allocator.h"
+
+#include <cstdint>
+
+namespace salloc
+{
+
+// Free list protection used by the block allocators when built with SALLOC_HARDENED.
+//  - next pointers are stored XOR-ed with a per-allocator secret and the address of the block holding them
+//  - every chunk has a bitmap of allocated blocks, which catches double frees and frees of foreign pointers
+//  - new chunks thread their blocks onto the free list in random order
+// Detected corruption aborts the process
+class FreeListGuard
+{
+public:
+    FreeListGuard();
+    ~FreeListGuard();
+
+    FreeListGuard(const FreeListGuard&) = delete;
+    FreeListGuard& operator=(const FreeListGuard&) = delete;
+
+    // Registers a new chunk and returns the head of its shuffled free list, which ends with tail
+    Block* AddChunk(Block* blocks, size_t blockSize, size_t capacity, Block* tail = nullptr);
+
+    // Marks the head block allocated and returns the next free block
+    Block* Pop(Block* head, size_t blockSize);
+
+    // Marks the block free and links it in front of head
+    void Push(Block* block, Block* head, size_t blockSize);
+
+    void Clear();
+
+private:
+    struct ChunkRange
+    {
+        char* begin;
+        char* end;
+        size_t blockSize;
+        uint64_t* allocated;
+    };
+
+    Block* Encode(const Block* block, Block* next) const;
+    Block* Decode(const Block* block) const;
+
+    ChunkRange* Find(const void* p) const;
+    size_t GetBlockIndex(const ChunkRange* range, const void* p, size_t blockSize) const;
+
+    uint64_t NextRandom();
+
+    uintptr_t secret;
+    uint64_t random;
+
+    // Sorted by address
+    ChunkRange* ranges;
+    size_t rangeCount;
+    size_t rangeCapacity;
+};
+
+inline Block* FreeListGuard::Encode(const Block* block, Block* next) const
+{
+    return (Block*)((uintptr_t)next ^ (uintptr_t)block ^ secret);
+}
+
+inline Block* FreeListGuard::Decode(const Block* block) const
+{
+    return (Block*)((uintptr_t)block->next ^ (uintptr_t)block ^ secret);
+}
+
+} // namespace salloc
@@ -0,0 +1,140 @@
+#pragma once
+
+// Hot path instrumentation for the allocators. Compiles to nothing unless built with SALLOC_INSTRUMENT.
+// Refills, upstream allocations and Clear calls are timed in ticks, rdtsc on x86, and recorded in log-linear histograms
+// per block size class. Free list pops are counted only. ExportInstrumentation hands the histograms to a callback
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SALLOC_RDTSC 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SALLOC_RDTSC 1
+#else
+#include <chrono>
+#endif
+
+namespace salloc
+{
+
+enum class InstrumentEvent
+{
+    free_list_pop,  // Allocation served straight from a free list, counted only
+    refill,         // Allocation that had to create or splice a chunk first
+    upstream_alloc, // salloc::Alloc and salloc::AlignedAlloc
+    clear,          // Clear of a block allocator
+};
+
+constexpr inline size_t instrument_event_count = 4;
+
+// Classes by block size rounded up to 8 bytes, the last class holds everything over 1016 bytes and class 0 is not tied to a size
+constexpr inline size_t instrument_class_unit = 8;
+constexpr inline size_t instrument_class_count = 128;
+
+// Each power of two range of values is split in 8 linear buckets, so bucket bounds are within 12.5% of the values in them
+struct Histogram
+{
+    static constexpr inline size_t sub_bucket_bits = 3;
+    static constexpr inline size_t sub_bucket_count = 1 << sub_bucket_bits;
+    static constexpr inline size_t bucket_count = (64 - sub_bucket_bits + 1) * sub_bucket_count;
+
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> buckets[bucket_count];
+
+    static size_t GetBucket(uint64_t value);
+
+    // Largest value recorded into the bucket
+    static uint64_t GetBucketBound(size_t bucket);
+
+    void Record(uint64_t value);
+
+    // Upper bound of the bucket holding the percentile, in [0, 100]
+    uint64_t GetPercentile(double percentile) const;
+};
+
+struct InstrumentRecord
+{
+    InstrumentEvent event;
+
+    // Upper bound of the block size class, zero when not tied to a size
+    size_t blockSize;
+
+    const Histogram& histogram;
+};
+
+using InstrumentExporter = void (*)(const InstrumentRecord& record, void* userData);
+
+// Calls the exporter for every histogram with anything recorded. No-op unless built with SALLOC_INSTRUMENT
+void ExportInstrumentation(InstrumentExporter exporter, void* userData = nullptr);
+void ResetInstrumentation();
+
+// Ticks per second, measured against the steady clock on the first call
+double GetTickFrequency();
+
+inline uint64_t ReadTicks()
+{
+#if defined(SALLOC_RDTSC) && defined(_MSC_VER)
+    return __rdtsc();
+#elif defined(SALLOC_RDTSC)
+    return __builtin_ia32_rdtsc();
+#else
+    // Nanoseconds of the steady clock elsewhere
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+#endif
+}
+
+#if defined(SALLOC_INSTRUMENT)
+
+extern Histogram instrumentHistograms[instrument_event_count][instrument_class_count];
+
+inline Histogram& GetInstrumentHistogram(InstrumentEvent event, size_t blockSize)
+{
+    size_t sizeClass = (blockSize + instrument_class_unit - 1) / instrument_class_unit;
+    if (sizeClass >= instrument_class_count)
+    {
+        sizeClass = instrument_class_count - 1;
+    }
+
+    return instrumentHistograms[(size_t)event][sizeClass];
+}
+
+// Records the ticks spent in its scope
+class InstrumentScope
+{
+public:
+    InstrumentScope(InstrumentEvent event, size_t blockSize)
+        : histogram{ GetInstrumentHistogram(event, blockSize) }
+        , begin{ ReadTicks() }
+    {
+    }
+
+    ~InstrumentScope()
+    {
+        histogram.Record(ReadTicks() - begin);
+    }
+
+    InstrumentScope(const InstrumentScope&) = delete;
+    InstrumentScope& operator=(const InstrumentScope&) = delete;
+
+private:
+    Histogram& histogram;
+    uint64_t begin;
+};
+
+#define sallocInstrumentScope(event, blockSize) salloc::InstrumentScope sallocScope(event, blockSize)
+#define sallocInstrumentCount(event, blockSize)                                                                                 \
+    salloc::GetInstrumentHistogram(event, blockSize).count.fetch_add(1, std::memory_order_relaxed)
+
+#else
+
+#define sallocInstrumentScope(event, blockSize) ((void)0)
+#define sallocInstrumentCount(event, blockSize) ((void)0)
+
+#endif
+
+} // namespace salloc
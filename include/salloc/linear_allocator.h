@@ -1,28 +1,60 @@
 #pragma once
 
 #include "allocator.h"
+#include "realtime.h"
 
 namespace salloc
 {
 
+enum class GuardMode
+{
+    none,
+    guard_page,     // Pages are committed one at a time, so the inaccessible page past the committed part catches overruns
+    electric_fence, // Every allocation ends flush against an inaccessible page of its own, and freed pages become inaccessible
+};
+
+// Address space reserved up front for LinearAllocator, committed commitSize at a time as allocations advance.
+// The page past the reservation is never committed
+struct LinearReservation
+{
+    size_t reservedSize = size_t(64) * 1024 * 1024 * 1024;
+    size_t commitSize = 64 * 1024;
+    GuardMode guard = GuardMode::none;
+};
+
 // You must nest allocate/free pairs
 class LinearAllocator : public Allocator
 {
 public:
     LinearAllocator(size_t initialCapacity = 16 * 1024);
+
+    // Realtime mode, memory and entries are carved from the budget and the upstream allocator is never called.
+    // Allocations past capacity or entryCapacity fail with nullptr instead of spilling to malloc
+    LinearAllocator(RealtimeBudget& budget, size_t capacity, size_t entryCapacity = 256, ExhaustionHandler onExhausted = nullptr);
+
+    // Virtual memory mode, the arena never moves so it grows in use instead of through GrowMemory.
+    // Allocations past the reservation fail with nullptr. Clear decommits pages past the peak since the previous Clear
+    LinearAllocator(const LinearReservation& reservation);
     ~LinearAllocator();
 
     virtual void* Allocate(size_t size) override;
     virtual void Free(void* p, size_t size) override;
     virtual void Clear() override;
 
+    // Extends or shrinks the top allocation in place
+    virtual void* Reallocate(void* p, size_t oldSize, size_t newSize) override;
+
     bool GrowMemory();
 
     size_t GetCapacity() const;
+    size_t GetCommittedSize() const;
     size_t GetAllocation() const;
     size_t GetMaxAllocation() const;
 
 private:
+    bool Commit(size_t size);
+    char* AllocateFenced(size_t size);
+
     struct MemoryEntry
     {
         char* data;
@@ -40,6 +72,16 @@ private:
 
     size_t allocation;
     size_t maxAllocation;
+
+    // Virtual memory mode only
+    bool reserved;
+    GuardMode guard;
+    size_t commitSize;
+    size_t committed;
+    size_t peakIndex;
+
+    RealtimeBudget* budget;
+    ExhaustionHandler onExhausted;
 };
 
 inline size_t LinearAllocator::GetCapacity() const
@@ -47,6 +89,12 @@ inline size_t LinearAllocator::GetCapacity() const
     return capacity;
 }
 
+// Same as the capacity outside virtual memory mode
+inline size_t LinearAllocator::GetCommittedSize() const
+{
+    return reserved ? committed : capacity;
+}
+
 inline size_t LinearAllocator::GetAllocation() const
 {
     return allocation;
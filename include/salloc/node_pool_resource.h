@@ -0,0 +1,87 @@
+#pragma once
+
+#include "allocator.h"
+#include "block_allocator.h"
+
+namespace salloc
+{
+
+// Allocator for node based containers like std::map and std::unordered_map.
+// Single object allocations go to a pool dedicated to their node size, which hands out blocks in allocation order
+// from contiguous runs, so nodes inserted one after another sit next to each other and apart from unrelated objects.
+// Everything else goes to an upstream BlockAllocator. StlAllocator routes single object allocations to AllocateNode,
+// which also catches a vector growing to a capacity of one
+class NodePoolResource : public Allocator
+{
+public:
+    static constexpr inline size_t max_node_size = 256;
+    static constexpr inline size_t node_unit = 8;
+    static constexpr inline size_t pool_count = max_node_size / node_unit;
+
+    NodePoolResource(size_t initialChunkSize = 16 * 1024);
+    ~NodePoolResource();
+
+    NodePoolResource(const NodePoolResource&) = delete;
+    NodePoolResource& operator=(const NodePoolResource&) = delete;
+
+    virtual void* Allocate(size_t size) override;
+    virtual void Free(void* p, size_t size) override;
+    virtual void Clear() override;
+
+    void* AllocateNode(size_t size);
+    void FreeNode(void* p, size_t size);
+
+    // Number of distinct node sizes seen so far
+    size_t GetPoolCount() const;
+    size_t GetNodeCount() const;
+
+    BlockAllocator& GetUpstream();
+
+private:
+    struct Pool
+    {
+        Chunk* chunks;
+        Block* freeList;
+
+        // Unused part of the newest chunk
+        char* cursor;
+        char* end;
+
+        size_t chunkSize;
+    };
+
+    size_t initialChunkSize;
+    size_t poolCount;
+    size_t nodeCount;
+
+    Pool pools[pool_count];
+
+    BlockAllocator upstream;
+};
+
+inline void* NodePoolResource::Allocate(size_t size)
+{
+    return upstream.Allocate(size);
+}
+
+inline void NodePoolResource::Free(void* p, size_t size)
+{
+    upstream.Free(p, size);
+}
+
+inline size_t NodePoolResource::GetPoolCount() const
+{
+    return poolCount;
+}
+
+inline size_t NodePoolResource::GetNodeCount() const
+{
+    return nodeCount;
+}
+
+inline BlockAllocator& NodePoolResource::GetUpstream()
+{
+    return upstream;
+}
+
+} // namespace salloc
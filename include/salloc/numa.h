@@ -0,0 +1,94 @@
+#pragma once
+
+#include "allocator.h"
+
+#include <mutex>
+
+namespace salloc
+{
+
+// Describes the NUMA nodes seen by the NUMA-aware allocators.
+// Replace currentNode to simulate a multi-node topology on a single-node machine
+struct NumaTopology
+{
+    size_t nodeCount;
+
+    // Returns the node of the calling thread
+    size_t (*currentNode)();
+
+    // Bind chunk memory to its node
+    bool bindMemory;
+};
+
+// Queries the topology of this machine. Single node where NUMA is not supported
+NumaTopology GetSystemNumaTopology();
+
+// Per-node address ranges chunks are carved from.
+// The node owning a pointer is found with a range check
+class NumaChunkPool
+{
+public:
+    static constexpr inline size_t max_node_count = 8;
+
+    NumaChunkPool(const NumaTopology& topology, size_t nodeCapacity);
+    ~NumaChunkPool();
+
+    NumaChunkPool(const NumaChunkPool&) = delete;
+    NumaChunkPool& operator=(const NumaChunkPool&) = delete;
+
+    // Caller must hold the lock of the node
+    void* AllocateChunk(size_t node, size_t size);
+    void Clear();
+
+    size_t GetNodeCount() const;
+    size_t GetCurrentNode() const;
+    size_t GetNode(const void* p) const;
+
+    std::mutex& GetLock(size_t node);
+
+private:
+    struct Node
+    {
+        char* mem;
+        size_t committed;
+        size_t index;
+        std::mutex lock;
+    };
+
+    NumaTopology topology;
+    size_t nodeCapacity;
+    Node nodes[max_node_count];
+};
+
+inline size_t NumaChunkPool::GetNodeCount() const
+{
+    return topology.nodeCount;
+}
+
+inline size_t NumaChunkPool::GetCurrentNode() const
+{
+    size_t node = topology.currentNode();
+    assert(node < topology.nodeCount);
+    return node;
+}
+
+inline size_t NumaChunkPool::GetNode(const void* p) const
+{
+    for (size_t i = 0; i < topology.nodeCount; ++i)
+    {
+        if (nodes[i].mem <= (const char*)p && (const char*)p < nodes[i].mem + nodeCapacity)
+        {
+            return i;
+        }
+    }
+
+    assert(false && "Pointer is not owned by this pool");
+    return 0;
+}
+
+inline std::mutex& NumaChunkPool::GetLock(size_t node)
+{
+    return nodes[node].lock;
+}
+
+} // namespace salloc
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "numa.h"
+
+namespace salloc
+{
+
+// Block allocator keeping a chunk pool and free lists per NUMA node.
+// Blocks are allocated from the node of the calling thread and freed back to the node owning the chunk.
+// Thread safe, each node is guarded by its own lock
+class NumaBlockAllocator : public Allocator
+{
+public:
+    static constexpr inline size_t max_block_size = 1024;
+    static constexpr inline size_t block_unit = 8;
+    static constexpr inline size_t block_size_count = max_block_size / block_unit;
+
+    NumaBlockAllocator(const NumaTopology& topology = GetSystemNumaTopology(),
+                       size_t initialChunkSize = 16 * 1024,
+                       size_t nodeCapacity = size_t(1) << 30);
+    ~NumaBlockAllocator();
+
+    virtual void* Allocate(size_t size) override;
+    virtual void Free(void* p, size_t size) override;
+    virtual void Clear() override;
+
+    size_t GetBlockCount() const;
+    size_t GetChunkCount() const;
+
+    size_t GetNodeCount() const;
+    size_t GetNode(const void* p) const;
+
+private:
+    struct Node
+    {
+        size_t blockCount;
+        size_t chunkCount;
+
+        size_t chunkSizes[block_size_count];
+        Block* freeList[block_size_count];
+    };
+
+    void ResetNodes();
+
+    NumaChunkPool pool;
+    size_t initialChunkSize;
+
+    Node nodes[NumaChunkPool::max_node_count];
+};
+
+inline size_t NumaBlockAllocator::GetNodeCount() const
+{
+    return pool.GetNodeCount();
+}
+
+inline size_t NumaBlockAllocator::GetNode(const void* p) const
+{
+    return pool.GetNode(p);
+}
+
+} // namespace salloc
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "numa.h"
+
+namespace salloc
+{
+
+// Fixed block allocator keeping a chunk pool and a free list per NUMA node.
+// Blocks are allocated from the node of the calling thread and freed back to the node owning the chunk.
+// Thread safe, each node is guarded by its own lock
+template <size_t blockSize>
+class NumaFixedBlockAllocator : public Allocator
+{
+public:
+    NumaFixedBlockAllocator(const NumaTopology& topology = GetSystemNumaTopology(),
+                            size_t initialBlockCapacity = 64,
+                            size_t nodeCapacity = size_t(1) << 30);
+    ~NumaFixedBlockAllocator();
+
+    void* Allocate(size_t size = blockSize) override;
+    void Free(void* p, size_t size = blockSize) override;
+    void Clear() override;
+
+    size_t GetChunkCount() const;
+    size_t GetBlockCount() const;
+
+    size_t GetNodeCount() const;
+    size_t GetNode(const void* p) const;
+
+private:
+    struct Node
+    {
+        size_t blockCapacity;
+        size_t chunkCount;
+        size_t blockCount;
+        Block* freeList;
+    };
+
+    void ResetNodes();
+
+    NumaChunkPool pool;
+    size_t initialBlockCapacity;
+
+    Node nodes[NumaChunkPool::max_node_count];
+};
+
+template <size_t blockSize>
+NumaFixedBlockAllocator<blockSize>::NumaFixedBlockAllocator(const NumaTopology& topology,
+                                                            size_t initialBlockCapacity,
+                                                            size_t nodeCapacity)
+    : pool(topology, nodeCapacity)
+    , initialBlockCapacity{ initialBlockCapacity }
+{
+    ResetNodes();
+}
+
+template <size_t blockSize>
+NumaFixedBlockAllocator<blockSize>::~NumaFixedBlockAllocator()
+{
+    Clear();
+}
+
+template <size_t blockSize>
+void* NumaFixedBlockAllocator<blockSize>::Allocate(size_t size)
+{
+    assert(size == blockSize);
+
+    if (size > blockSize)
+    {
+        return salloc::Alloc(size);
+    }
+
+    size_t n = pool.GetCurrentNode();
+    Node& node = nodes[n];
+
+    std::lock_guard<std::mutex> lock(pool.GetLock(n));
+
+    if (node.freeList == nullptr)
+    {
+        node.blockCapacity += node.blockCapacity / 2;
+
+        Block* blocks = (Block*)pool.AllocateChunk(n, node.blockCapacity * blockSize);
+        if (blocks == nullptr)
+        {
+            return nullptr;
+        }
+
+        // Build a linked list for the free list.
+        for (size_t i = 0; i < node.blockCapacity - 1; ++i)
+        {
+            Block* block = (Block*)((char*)blocks + blockSize * i);
+            Block* next = (Block*)((char*)blocks + blockSize * (i + 1));
+            block->next = next;
+        }
+        Block* last = (Block*)((char*)blocks + blockSize * (node.blockCapacity - 1));
+        last->next = nullptr;
+
+        ++node.chunkCount;
+
+        node.freeList = blocks;
+    }
+
+    Block* block = node.freeList;
+    node.freeList = block->next;
+    ++node.blockCount;
+
+    return block;
+}
+
+template <size_t blockSize>
+void NumaFixedBlockAllocator<blockSize>::Free(void* p, size_t size)
+{
+    if (size > blockSize)
+    {
+        salloc::Free(p);
+        return;
+    }
+
+    // Return the block to the node owning its chunk
+    size_t n = pool.GetNode(p);
+    Node& node = nodes[n];
+
+    std::lock_guard<std::mutex> lock(pool.GetLock(n));
+
+    Block* block = (Block*)p;
+    block->next = node.freeList;
+    node.freeList = block;
+    --node.blockCount;
+}
+
+template <size_t blockSize>
+void NumaFixedBlockAllocator<blockSize>::Clear()
+{
+    pool.Clear();
+    ResetNodes();
+}
+
+template <size_t blockSize>
+size_t NumaFixedBlockAllocator<blockSize>::GetChunkCount() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < pool.GetNodeCount(); ++i)
+    {
+        count += nodes[i].chunkCount;
+    }
+
+    return count;
+}
+
+template <size_t blockSize>
+size_t NumaFixedBlockAllocator<blockSize>::GetBlockCount() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < pool.GetNodeCount(); ++i)
+    {
+        count += nodes[i].blockCount;
+    }
+
+    return count;
+}
+
+template <size_t blockSize>
+size_t NumaFixedBlockAllocator<blockSize>::GetNodeCount() const
+{
+    return pool.GetNodeCount();
+}
+
+template <size_t blockSize>
+size_t NumaFixedBlockAllocator<blockSize>::GetNode(const void* p) const
+{
+    return pool.GetNode(p);
+}
+
+template <size_t blockSize>
+void NumaFixedBlockAllocator<blockSize>::ResetNodes()
+{
+    for (size_t i = 0; i < NumaChunkPool::max_node_count; ++i)
+    {
+        Node& node = nodes[i];
+        node.blockCapacity = initialBlockCapacity;
+        node.chunkCount = 0;
+        node.blockCount = 0;
+        node.freeList = nullptr;
+    }
+}
+
+} // namespace salloc
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "fixed_block_allocator.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace salloc
+{
+
+// Object cache in the style of the slab allocator.
+// Objects are constructed on their first allocation and stay constructed across Free/Allocate,
+// so the constructor and destructor are only paid when the pool grows or gets cleared.
+// Freed objects must be returned in their constructed state, the reset hook can do that
+template <typename T>
+class ObjectPool
+{
+public:
+    using ResetFunction = void (*)(T& object);
+
+    ObjectPool(ResetFunction reset = nullptr, size_t initialBlockCapacity = 64);
+    ~ObjectPool();
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    T* Allocate();
+    void Free(T* object);
+
+    // Destroys all cached objects and releases the chunks
+    void Clear();
+
+    // Visits live objects chunk by chunk
+    template <typename Function>
+    void ForEach(Function&& function);
+
+    size_t GetCount() const;
+    size_t GetChunkCount() const;
+
+private:
+    enum : uint32_t
+    {
+        empty = 0, // Never constructed
+        cached = 1,
+        live = 2,
+    };
+
+    // The free list link is kept out of the object so it survives being freed
+    struct Slot
+    {
+        Block link;
+        uint32_t state;
+        alignas(T) unsigned char object[sizeof(T)];
+    };
+
+    static_assert(alignof(T) <= alignof(std::max_align_t));
+
+    static Slot* GetSlot(T* object);
+
+    FixedBlockAllocator<sizeof(Slot)> allocator;
+    ResetFunction reset;
+};
+
+template <typename T>
+ObjectPool<T>::ObjectPool(ResetFunction reset, size_t initialBlockCapacity)
+    : allocator(initialBlockCapacity)
+    , reset{ reset }
+{
+}
+
+template <typename T>
+ObjectPool<T>::~ObjectPool()
+{
+    Clear();
+}
+
+template <typename T>
+T* ObjectPool<T>::Allocate()
+{
+    Slot* slot = (Slot*)allocator.Allocate();
+    T* object = (T*)slot->object;
+
+    if (slot->state == empty)
+    {
+        new (object) T();
+    }
+
+    slot->state = live;
+    return object;
+}
+
+template <typename T>
+void ObjectPool<T>::Free(T* object)
+{
+    Slot* slot = GetSlot(object);
+    assert(slot->state == live);
+
+    if (reset)
+    {
+        reset(*object);
+    }
+
+    slot->state = cached;
+    allocator.Free(slot);
+}
+
+template <typename T>
+void ObjectPool<T>::Clear()
+{
+    const Chunk* chunk = allocator.GetChunks();
+    while (chunk)
+    {
+        for (size_t i = 0; i < chunk->capacity; ++i)
+        {
+            Slot* slot = (Slot*)((char*)chunk->blocks + chunk->blockSize * i);
+            sallocUnpoison(slot, sizeof(Slot));
+            if (slot->state != empty)
+            {
+                ((T*)slot->object)->~T();
+            }
+        }
+
+        chunk = chunk->next;
+    }
+
+    allocator.Clear();
+}
+
+template <typename T>
+template <typename Function>
+void ObjectPool<T>::ForEach(Function&& function)
+{
+    const Chunk* chunk = allocator.GetChunks();
+    while (chunk)
+    {
+        for (size_t i = 0; i < chunk->capacity; ++i)
+        {
+            Slot* slot = (Slot*)((char*)chunk->blocks + chunk->blockSize * i);
+
+            // Free slots are poisoned, peek at the state only
+            sallocUnpoison(&slot->state, sizeof(slot->state));
+            if (slot->state == live)
+            {
+                function(*(T*)slot->object);
+            }
+            else
+            {
+                sallocPoison(slot, sizeof(Slot));
+            }
+        }
+
+        chunk = chunk->next;
+    }
+}
+
+template <typename T>
+size_t ObjectPool<T>::GetCount() const
+{
+    return allocator.GetBlockCount();
+}
+
+template <typename T>
+size_t ObjectPool<T>::GetChunkCount() const
+{
+    return allocator.GetChunkCount();
+}
+
+template <typename T>
+typename ObjectPool<T>::Slot* ObjectPool<T>::GetSlot(T* object)
+{
+    return (Slot*)((char*)object - offsetof(Slot, object));
+}
+
+} // namespace salloc
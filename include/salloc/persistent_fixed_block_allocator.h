@@ -0,0 +1,308 @@
+#pragma once
+
+#include "allocator.h"
+#include "virtual_memory.h"
+
+#include <cstdint>
+#include <cstdio>
+
+namespace salloc
+{
+
+// Fixed block allocator whose chunks, free list and statistics all live in one relocatable region.
+// Chunk and block links are offsets from the region base, so the region can be saved to a file
+// and mapped back as a whole at any address, instead of reallocating and relinking every block
+template <size_t blockSize>
+class PersistentFixedBlockAllocator : public Allocator
+{
+    static_assert(blockSize >= sizeof(uint64_t), "Blocks must hold a free list offset");
+
+public:
+    PersistentFixedBlockAllocator(size_t maxRegionSize = 1024 * 1024 * 1024, size_t initialBlockCapacity = 64);
+    ~PersistentFixedBlockAllocator();
+
+    PersistentFixedBlockAllocator(const PersistentFixedBlockAllocator&) = delete;
+    PersistentFixedBlockAllocator& operator=(const PersistentFixedBlockAllocator&) = delete;
+
+    // Returns nullptr once the region is full
+    void* Allocate(size_t size = blockSize) override;
+    void Free(void* p, size_t size = blockSize) override;
+    void Clear() override;
+
+    // Writes the used part of the region
+    bool Save(const char* path) const;
+
+    // Replaces the region with a saved one, mapped straight from the file
+    bool Load(const char* path);
+
+    // Entry point to the saved objects
+    void SetRoot(const void* p);
+    void* GetRoot() const;
+
+    size_t GetOffset(const void* p) const;
+    void* GetPointer(size_t offset) const;
+
+    size_t GetChunkCount() const;
+    size_t GetBlockCount() const;
+    size_t GetRegionSize() const;
+
+private:
+    struct Header
+    {
+        uint64_t magic;
+        uint64_t recordedBlockSize;
+        uint64_t size;
+
+        uint64_t blockCapacity;
+        uint64_t chunkCount;
+        uint64_t blockCount;
+
+        uint64_t chunks;
+        uint64_t freeList;
+        uint64_t root;
+    };
+
+    struct ArenaChunk
+    {
+        uint64_t capacity;
+        uint64_t next;
+    };
+
+    static constexpr inline uint64_t header_magic = 0x53414c4c4f434152ull; // "SALLOCAR"
+    static constexpr inline size_t header_size = (sizeof(Header) + 15) & ~size_t(15);
+    static constexpr inline size_t chunk_header_size = (sizeof(ArenaChunk) + 15) & ~size_t(15);
+
+    // Offset zero is the header, so it ends lists
+    uint64_t& Next(uint64_t offset) const;
+
+    bool Commit(size_t size);
+
+    char* base;
+    size_t maxRegionSize;
+    size_t committed;
+    size_t initialBlockCapacity;
+
+    Header* header;
+};
+
+template <size_t blockSize>
+PersistentFixedBlockAllocator<blockSize>::PersistentFixedBlockAllocator(size_t maxRegionSize, size_t initialBlockCapacity)
+    : maxRegionSize{ RoundUpToPage(maxRegionSize) }
+    , committed{ 0 }
+    , initialBlockCapacity{ initialBlockCapacity }
+{
+    base = (char*)ReserveMemory(this->maxRegionSize);
+    assert(base != nullptr);
+
+    header = (Header*)base;
+    Clear();
+}
+
+template <size_t blockSize>
+PersistentFixedBlockAllocator<blockSize>::~PersistentFixedBlockAllocator()
+{
+    ReleaseMemory(base, maxRegionSize);
+}
+
+template <size_t blockSize>
+void* PersistentFixedBlockAllocator<blockSize>::Allocate(size_t size)
+{
+    assert(size <= blockSize);
+    sallocNotUsed(size);
+
+    if (header->freeList == 0)
+    {
+        // Grow by half, or by what's left of the region
+        uint64_t blockCapacity = header->blockCapacity + header->blockCapacity / 2;
+        uint64_t begin = (header->size + 15) & ~uint64_t(15);
+        size_t available = maxRegionSize - begin;
+        if (available < chunk_header_size + blockSize)
+        {
+            return nullptr;
+        }
+        if (chunk_header_size + blockCapacity * blockSize > available)
+        {
+            blockCapacity = (available - chunk_header_size) / blockSize;
+        }
+
+        if (!Commit(begin + chunk_header_size + blockCapacity * blockSize))
+        {
+            return nullptr;
+        }
+
+        ArenaChunk* chunk = (ArenaChunk*)(base + begin);
+        chunk->capacity = blockCapacity;
+        chunk->next = header->chunks;
+
+        // Build a linked list of offsets for the free list.
+        uint64_t blocks = begin + chunk_header_size;
+        for (uint64_t i = 0; i < blockCapacity - 1; ++i)
+        {
+            Next(blocks + blockSize * i) = blocks + blockSize * (i + 1);
+        }
+        Next(blocks + blockSize * (blockCapacity - 1)) = 0;
+
+        header->chunks = begin;
+        header->freeList = blocks;
+        header->blockCapacity = blockCapacity;
+        header->size = blocks + blockCapacity * blockSize;
+        ++header->chunkCount;
+    }
+
+    uint64_t block = header->freeList;
+    header->freeList = Next(block);
+    ++header->blockCount;
+
+    return base + block;
+}
+
+template <size_t blockSize>
+void PersistentFixedBlockAllocator<blockSize>::Free(void* p, size_t size)
+{
+    assert(size <= blockSize);
+    assert(base + header_size <= (char*)p && (char*)p < base + header->size);
+    sallocNotUsed(size);
+
+    uint64_t block = GetOffset(p);
+    Next(block) = header->freeList;
+    header->freeList = block;
+    --header->blockCount;
+}
+
+template <size_t blockSize>
+void PersistentFixedBlockAllocator<blockSize>::Clear()
+{
+    bool committedHeader = Commit(header_size);
+    assert(committedHeader);
+    sallocNotUsed(committedHeader);
+
+    header->magic = header_magic;
+    header->recordedBlockSize = blockSize;
+    header->size = header_size;
+    header->blockCapacity = initialBlockCapacity;
+    header->chunkCount = 0;
+    header->blockCount = 0;
+    header->chunks = 0;
+    header->freeList = 0;
+    header->root = 0;
+}
+
+template <size_t blockSize>
+bool PersistentFixedBlockAllocator<blockSize>::Save(const char* path) const
+{
+    FILE* file = std::fopen(path, "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    size_t written = std::fwrite(base, 1, header->size, file);
+    bool closed = std::fclose(file) == 0;
+
+    return written == header->size && closed;
+}
+
+template <size_t blockSize>
+bool PersistentFixedBlockAllocator<blockSize>::Load(const char* path)
+{
+    // Check the header before touching the region
+    Header saved;
+    FILE* file = std::fopen(path, "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    size_t read = std::fread(&saved, sizeof(Header), 1, file);
+    std::fclose(file);
+
+    if (read != 1 || saved.magic != header_magic || saved.recordedBlockSize != blockSize || saved.size > maxRegionSize)
+    {
+        return false;
+    }
+
+    DecommitMemory(base, committed);
+    committed = 0;
+
+    if (!MapFile(path, base, saved.size))
+    {
+        Clear();
+        return false;
+    }
+
+    committed = RoundUpToPage(saved.size);
+    return true;
+}
+
+template <size_t blockSize>
+void PersistentFixedBlockAllocator<blockSize>::SetRoot(const void* p)
+{
+    header->root = p ? GetOffset(p) : 0;
+}
+
+template <size_t blockSize>
+void* PersistentFixedBlockAllocator<blockSize>::GetRoot() const
+{
+    return header->root ? base + header->root : nullptr;
+}
+
+template <size_t blockSize>
+size_t PersistentFixedBlockAllocator<blockSize>::GetOffset(const void* p) const
+{
+    return (const char*)p - base;
+}
+
+template <size_t blockSize>
+void* PersistentFixedBlockAllocator<blockSize>::GetPointer(size_t offset) const
+{
+    return base + offset;
+}
+
+template <size_t blockSize>
+size_t PersistentFixedBlockAllocator<blockSize>::GetChunkCount() const
+{
+    return header->chunkCount;
+}
+
+template <size_t blockSize>
+size_t PersistentFixedBlockAllocator<blockSize>::GetBlockCount() const
+{
+    return header->blockCount;
+}
+
+template <size_t blockSize>
+size_t PersistentFixedBlockAllocator<blockSize>::GetRegionSize() const
+{
+    return header->size;
+}
+
+template <size_t blockSize>
+uint64_t& PersistentFixedBlockAllocator<blockSize>::Next(uint64_t offset) const
+{
+    return *(uint64_t*)(base + offset);
+}
+
+template <size_t blockSize>
+bool PersistentFixedBlockAllocator<blockSize>::Commit(size_t size)
+{
+    if (size <= committed)
+    {
+        return true;
+    }
+
+    // Commit by doubling to keep the system calls rare
+    size_t newCommitted = RoundUpToPage(size > committed * 2 ? size : committed * 2);
+    if (newCommitted > maxRegionSize)
+    {
+        newCommitted = maxRegionSize;
+    }
+
+    if (!CommitMemory(base + committed, newCommitted - committed))
+    {
+        return false;
+    }
+
+    committed = newCommitted;
+    return true;
+}
+
+} // namespace salloc
@@ -2,6 +2,10 @@
 
 #include "allocator.h"
 
+#if defined(SALLOC_HARDENED)
+#include "hardening.h"
+#endif
+
 #include <span>
 #include <vector>
 
@@ -35,12 +39,27 @@ public:
     virtual void Free(void* p, size_t size) override;
     virtual void Clear() override;
 
+    virtual void* Reallocate(void* p, size_t oldSize, size_t newSize) override;
+
+    // Build free blocks ahead of time, so the first allocations of a size class don't create chunks
+    void Reserve(size_t size, size_t count);
+    void Prewarm(std::span<const Reservation> profile);
+
+    // Replenish() tops up every size class whose free block count dropped below its watermark
+    void SetWatermark(size_t size, size_t count);
+    void Replenish();
+
     size_t GetBlockCount() const;
     size_t GetChunkCount() const;
 
     size_t GetBlockSizeCount() const;
+    size_t GetChunkSize(size_t size) const;
+    size_t GetFreeCount(size_t size) const;
 
 private:
+    // Adds a chunk of at least minCapacity blocks to the free list of the size class
+    void CreateChunk(size_t index, size_t minCapacity);
+
     struct SizeMap
     {
         SizeMap(std::span<size_t> blockSizes)
@@ -77,9 +96,17 @@ private:
     size_t blockCount;
     size_t chunkCount;
 
-    size_t chunkSize;
+    // Number of blocks in the last chunk of each size class
+    size_t* blockCapacities;
     Chunk* chunks;
     Block** freeList;
+
+    size_t* freeCounts;
+    size_t* watermarks;
+
+#if defined(SALLOC_HARDENED)
+    FreeListGuard guard;
+#endif
 };
 
 inline size_t PredefinedBlockAllocator::GetBlockCount() const
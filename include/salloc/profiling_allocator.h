@@ -0,0 +1,334 @@
+#pragma once
+
+#include "allocator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+namespace salloc
+{
+
+// Return addresses of the calling thread, innermost first. Returns the number of frames written
+size_t CaptureStack(void** frames, size_t maxDepth);
+
+// Writes the function name of the address, or module+offset, or the plain address when no symbol is known
+void WriteSymbol(FILE* file, void* address);
+
+// Writes the memory map of the process in the format pprof expects after a legacy heap profile. No-op outside Linux
+void WriteMappedLibraries(FILE* file);
+
+// Decorator recording where allocations of the inner allocator come from.
+// About one allocation per sampleInterval bytes is sampled, with the interval drawn from an exponential distribution
+// like tcmalloc's sampler, so the cost stays low and large allocations are sampled more often than small ones.
+// Sampled allocations keep their backtrace until freed, and the live set is exported as collapsed stacks for flame graphs
+// or as a legacy heap profile for pprof. Zero sampleInterval samples every allocation
+template <typename Inner>
+class ProfilingAllocator : public Allocator
+{
+public:
+    static constexpr inline size_t max_stack_depth = 32;
+    static constexpr inline size_t default_sample_interval = 512 * 1024;
+
+    ProfilingAllocator();
+
+    // Remaining arguments construct the inner allocator
+    template <typename... Args>
+    ProfilingAllocator(size_t sampleInterval, Args&&... args);
+
+    ProfilingAllocator(const ProfilingAllocator&) = delete;
+    ProfilingAllocator& operator=(const ProfilingAllocator&) = delete;
+
+    virtual void* Allocate(size_t size) override;
+    virtual void Free(void* p, size_t size) override;
+    virtual void Clear() override;
+    virtual void* Reallocate(void* p, size_t oldSize, size_t newSize) override;
+
+    // Lines of "outermost;...;innermost bytes", with bytes estimated from the samples
+    void WriteCollapsedStacks(FILE* file) const;
+
+    // gperftools heap profile, readable by pprof
+    void WriteHeapProfile(FILE* file) const;
+
+    size_t GetSampleCount() const;
+
+    // Live bytes estimated from the samples
+    size_t GetEstimatedSize() const;
+
+    Inner& GetInner();
+
+private:
+    struct Sample
+    {
+        size_t size;
+        double weight;
+
+        size_t depth;
+        void* frames[max_stack_depth];
+    };
+
+    void Record(void* p, size_t size);
+    void Erase(void* p);
+
+    // Number of allocations a sample of the size stands for, including the ones the sampler skipped
+    double GetWeight(size_t size) const;
+
+    // Bytes until the next sample
+    size_t NextInterval();
+
+    // Samples with the same stack, in stack order
+    std::vector<std::vector<const Sample*>> GroupByStack() const;
+
+    size_t sampleInterval;
+    size_t bytesUntilSample;
+    uint64_t random;
+
+    std::unordered_map<const void*, Sample> samples;
+
+    Inner inner;
+};
+
+template <typename Inner>
+ProfilingAllocator<Inner>::ProfilingAllocator()
+    : ProfilingAllocator(default_sample_interval)
+{
+}
+
+template <typename Inner>
+template <typename... Args>
+ProfilingAllocator<Inner>::ProfilingAllocator(size_t sampleInterval, Args&&... args)
+    : sampleInterval{ sampleInterval }
+    , random{ 0x9e3779b97f4a7c15ull }
+    , inner(std::forward<Args>(args)...)
+{
+    bytesUntilSample = NextInterval();
+}
+
+template <typename Inner>
+void* ProfilingAllocator<Inner>::Allocate(size_t size)
+{
+    void* p = inner.Inner::Allocate(size);
+
+    if (size < bytesUntilSample)
+    {
+        bytesUntilSample -= size;
+    }
+    else if (p)
+    {
+        Record(p, size);
+    }
+
+    return p;
+}
+
+template <typename Inner>
+void ProfilingAllocator<Inner>::Free(void* p, size_t size)
+{
+    if (!samples.empty())
+    {
+        Erase(p);
+    }
+
+    inner.Inner::Free(p, size);
+}
+
+template <typename Inner>
+void ProfilingAllocator<Inner>::Clear()
+{
+    samples.clear();
+    inner.Inner::Clear();
+}
+
+template <typename Inner>
+void* ProfilingAllocator<Inner>::Reallocate(void* p, size_t oldSize, size_t newSize)
+{
+    void* newP = inner.Inner::Reallocate(p, oldSize, newSize);
+    if (newP == nullptr && newSize != 0)
+    {
+        return nullptr;
+    }
+
+    // Sampled allocations stay sampled with the stack they were allocated from
+    if (!samples.empty())
+    {
+        auto node = samples.extract(p);
+        if (node && newP)
+        {
+            node.key() = newP;
+            node.mapped().size = newSize;
+            node.mapped().weight = GetWeight(newSize);
+            samples.insert(std::move(node));
+            return newP;
+        }
+    }
+
+    // Otherwise the growth counts as a new allocation
+    size_t growth = newSize > oldSize ? newSize - oldSize : 0;
+    if (growth < bytesUntilSample)
+    {
+        bytesUntilSample -= growth;
+    }
+    else if (newP)
+    {
+        Record(newP, newSize);
+    }
+
+    return newP;
+}
+
+template <typename Inner>
+void ProfilingAllocator<Inner>::WriteCollapsedStacks(FILE* file) const
+{
+    for (const std::vector<const Sample*>& group : GroupByStack())
+    {
+        const Sample* sample = group.front();
+
+        double bytes = 0.0;
+        for (const Sample* s : group)
+        {
+            bytes += s->weight * s->size;
+        }
+
+        for (size_t i = sample->depth; i > 0; --i)
+        {
+            WriteSymbol(file, sample->frames[i - 1]);
+            std::fputc(i > 1 ? ';' : ' ', file);
+        }
+        std::fprintf(file, "%llu\n", (unsigned long long)std::llround(bytes));
+    }
+}
+
+template <typename Inner>
+void ProfilingAllocator<Inner>::WriteHeapProfile(FILE* file) const
+{
+    // pprof scales the sampled counts back up with the interval itself
+    size_t totalBytes = 0;
+    for (const auto& [p, sample] : samples)
+    {
+        totalBytes += sample.size;
+    }
+
+    unsigned long long interval = sampleInterval == 0 ? 1 : sampleInterval;
+    std::fprintf(
+        file, "heap profile: %6zu: %8zu [%6zu: %8zu] @ heap_v2/%llu\n", samples.size(), totalBytes, samples.size(), totalBytes,
+        interval
+    );
+
+    for (const std::vector<const Sample*>& group : GroupByStack())
+    {
+        size_t bytes = 0;
+        for (const Sample* s : group)
+        {
+            bytes += s->size;
+        }
+
+        std::fprintf(file, "%6zu: %8zu [%6zu: %8zu] @", group.size(), bytes, group.size(), bytes);
+        const Sample* sample = group.front();
+        for (size_t i = 0; i < sample->depth; ++i)
+        {
+            std::fprintf(file, " 0x%llx", (unsigned long long)(uintptr_t)sample->frames[i]);
+        }
+        std::fputc('\n', file);
+    }
+
+    std::fprintf(file, "\nMAPPED_LIBRARIES:\n");
+    WriteMappedLibraries(file);
+}
+
+template <typename Inner>
+size_t ProfilingAllocator<Inner>::GetSampleCount() const
+{
+    return samples.size();
+}
+
+template <typename Inner>
+size_t ProfilingAllocator<Inner>::GetEstimatedSize() const
+{
+    double bytes = 0.0;
+    for (const auto& [p, sample] : samples)
+    {
+        bytes += sample.weight * sample.size;
+    }
+
+    return (size_t)std::llround(bytes);
+}
+
+template <typename Inner>
+Inner& ProfilingAllocator<Inner>::GetInner()
+{
+    return inner;
+}
+
+template <typename Inner>
+void ProfilingAllocator<Inner>::Record(void* p, size_t size)
+{
+    bytesUntilSample = NextInterval();
+
+    Sample& sample = samples[p];
+    sample.size = size;
+
+    sample.weight = GetWeight(size);
+    sample.depth = CaptureStack(sample.frames, max_stack_depth);
+}
+
+template <typename Inner>
+void ProfilingAllocator<Inner>::Erase(void* p)
+{
+    samples.erase(p);
+}
+
+template <typename Inner>
+double ProfilingAllocator<Inner>::GetWeight(size_t size) const
+{
+    return sampleInterval == 0 ? 1.0 : 1.0 / (1.0 - std::exp(-double(size) / double(sampleInterval)));
+}
+
+template <typename Inner>
+size_t ProfilingAllocator<Inner>::NextInterval()
+{
+    if (sampleInterval == 0)
+    {
+        return 0;
+    }
+
+    // xorshift64*, uniform in (0, 1]
+    random ^= random >> 12;
+    random ^= random << 25;
+    random ^= random >> 27;
+    double u = double((random * 0x2545f4914f6cdd1dull) >> 11) * (1.0 / 9007199254740992.0);
+
+    return (size_t)(-std::log(1.0 - u) * double(sampleInterval)) + 1;
+}
+
+template <typename Inner>
+std::vector<std::vector<const typename ProfilingAllocator<Inner>::Sample*>> ProfilingAllocator<Inner>::GroupByStack() const
+{
+    std::vector<const Sample*> sorted;
+    sorted.reserve(samples.size());
+    for (const auto& [p, sample] : samples)
+    {
+        sorted.push_back(&sample);
+    }
+
+    auto less = [](const Sample* a, const Sample* b) {
+        return std::lexicographical_compare(a->frames, a->frames + a->depth, b->frames, b->frames + b->depth);
+    };
+    std::sort(sorted.begin(), sorted.end(), less);
+
+    std::vector<std::vector<const Sample*>> groups;
+    for (const Sample* sample : sorted)
+    {
+        if (groups.empty() || less(groups.back().front(), sample))
+        {
+            groups.emplace_back();
+        }
+        groups.back().push_back(sample);
+    }
+
+    return groups;
+}
+
+} // namespace salloc
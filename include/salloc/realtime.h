@@ -0,0 +1,71 @@
+#pragma once
+
+#include "allocator.h"
+
+#include <cstddef>
+
+namespace salloc
+{
+
+// Called when an allocator in realtime mode runs out of budget, right before the allocation returns nullptr
+using ExhaustionHandler = void (*)(size_t size);
+
+inline void* ReportExhaustion(ExhaustionHandler handler, size_t size)
+{
+    if (handler)
+    {
+        handler(size);
+    }
+
+    return nullptr;
+}
+
+// Fixed memory budget for allocators in realtime mode.
+// The whole budget is committed, locked in RAM and touched up front, then carved out with a bump pointer,
+// so allocating from it never makes a system call. Memory is only given back when the budget is destroyed.
+// Not thread safe, share a budget only between allocators used by the same thread
+class RealtimeBudget
+{
+public:
+    RealtimeBudget(size_t size);
+    ~RealtimeBudget();
+
+    RealtimeBudget(const RealtimeBudget&) = delete;
+    RealtimeBudget& operator=(const RealtimeBudget&) = delete;
+
+    // Returns nullptr when the budget is exhausted
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Carves a chunk with its header placed after the blocks.
+    // Capacity shrinks to what's left of the budget, returns nullptr when not even minCapacity blocks fit
+    Chunk* AllocateChunk(size_t blockSize, size_t capacity, size_t minCapacity, size_t alignment = alignof(std::max_align_t));
+
+    size_t GetSize() const;
+    size_t GetRemaining() const;
+
+    // False when locking the pages failed, e.g. over RLIMIT_MEMLOCK
+    bool IsLocked() const;
+
+private:
+    char* mem;
+    size_t size;
+    size_t index;
+    bool locked;
+};
+
+inline size_t RealtimeBudget::GetSize() const
+{
+    return size;
+}
+
+inline size_t RealtimeBudget::GetRemaining() const
+{
+    return size - index;
+}
+
+inline bool RealtimeBudget::IsLocked() const
+{
+    return locked;
+}
+
+} // namespace salloc
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "allocator.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace salloc
+{
+
+// FIFO allocator for records allocated in arrival order and released in about the same order.
+// The ring is mapped twice back to back, so a record crossing the end of the ring stays contiguous in memory.
+// One producer thread may allocate while one consumer thread frees, without locks
+class RingAllocator : public Allocator
+{
+public:
+    static constexpr inline size_t record_alignment = 8;
+    static constexpr inline size_t cache_line_size = 64;
+
+    // Capacity is rounded up to a power of two multiple of the allocation granularity
+    RingAllocator(size_t capacity = 1024 * 1024);
+    ~RingAllocator();
+
+    RingAllocator(const RingAllocator&) = delete;
+    RingAllocator& operator=(const RingAllocator&) = delete;
+
+    // Producer side. Returns nullptr while the ring has no room for the record
+    virtual void* Allocate(size_t size) override;
+
+    // Consumer side. Records freed out of order hold their space until every older record is freed
+    virtual void Free(void* p, size_t size) override;
+
+    // Neither side may be in use at the time
+    virtual void Clear() override;
+
+    size_t GetCapacity() const;
+
+    // Bytes not yet reclaimed, including record headers
+    size_t GetUsedSize() const;
+
+private:
+    // Record size including the header, the lowest bit marks the record freed
+    struct RecordHeader
+    {
+        uint64_t size;
+    };
+
+    static constexpr inline size_t header_size = sizeof(RecordHeader);
+    static constexpr inline uint64_t freed_bit = 1;
+
+    char* base;
+    size_t capacity;
+
+    // Running offsets, the position in the ring is the offset modulo capacity
+    alignas(cache_line_size) std::atomic<uint64_t> head;
+    uint64_t cachedTail;
+
+    alignas(cache_line_size) std::atomic<uint64_t> tail;
+    uint64_t cachedHead;
+};
+
+inline size_t RingAllocator::GetCapacity() const
+{
+    return capacity;
+}
+
+inline size_t RingAllocator::GetUsedSize() const
+{
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+} // namespace salloc
@@ -0,0 +1,59 @@
+#pragma once
+
+// Memory poisoning annotations for AddressSanitizer and Valgrind.
+// Free blocks and unused arena memory are poisoned, so use-after-free and overruns into them are reported.
+// Compiles to nothing unless built with -fsanitize=address or SALLOC_VALGRIND
+
+#include <cstddef>
+
+#if defined(__SANITIZE_ADDRESS__)
+#define SALLOC_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SALLOC_ASAN 1
+#endif
+#endif
+
+#if defined(SALLOC_ASAN)
+#include <sanitizer/asan_interface.h>
+#endif
+
+#if defined(SALLOC_VALGRIND)
+#include <valgrind/memcheck.h>
+#endif
+
+#if defined(SALLOC_ASAN) && defined(SALLOC_VALGRIND)
+#define sallocPoison(p, size)                                                                                                   \
+    do                                                                                                                          \
+    {                                                                                                                           \
+        ASAN_POISON_MEMORY_REGION(p, size);                                                                                     \
+        VALGRIND_MAKE_MEM_NOACCESS(p, size);                                                                                    \
+    } while (0)
+#define sallocUnpoison(p, size)                                                                                                 \
+    do                                                                                                                          \
+    {                                                                                                                           \
+        ASAN_UNPOISON_MEMORY_REGION(p, size);                                                                                   \
+        VALGRIND_MAKE_MEM_DEFINED(p, size);                                                                                     \
+    } while (0)
+#elif defined(SALLOC_ASAN)
+#define sallocPoison(p, size) ASAN_POISON_MEMORY_REGION(p, size)
+#define sallocUnpoison(p, size) ASAN_UNPOISON_MEMORY_REGION(p, size)
+#elif defined(SALLOC_VALGRIND)
+#define sallocPoison(p, size) VALGRIND_MAKE_MEM_NOACCESS(p, size)
+#define sallocUnpoison(p, size) VALGRIND_MAKE_MEM_DEFINED(p, size)
+#else
+#define sallocPoison(p, size) ((void)(p), (void)(size))
+#define sallocUnpoison(p, size) ((void)(p), (void)(size))
+#endif
+
+namespace salloc
+{
+
+// Poisoned gap left after every stack and linear allocation to catch overruns
+#if defined(SALLOC_ASAN) || defined(SALLOC_VALGRIND)
+constexpr inline size_t redzone_size = 16;
+#else
+constexpr inline size_t redzone_size = 0;
+#endif
+
+} // namespace salloc
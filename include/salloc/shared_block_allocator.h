@@ -0,0 +1,116 @@
+#pragma once
+
+#include "allocator.h"
+#include "virtual_memory.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace salloc
+{
+
+// Block allocator whose chunks live in a shared memory region, so several processes can allocate from and free into the same pool.
+// The region may be mapped at a different address in every process, so free lists link blocks by their offset from the region base.
+// Free list heads are tagged with a counter against ABA and updated with lock-free atomics placed in the region itself
+class SharedBlockAllocator : public Allocator
+{
+public:
+    static constexpr inline size_t max_block_size = 1024;
+    static constexpr inline size_t block_unit = 8;
+    static constexpr inline size_t block_size_count = max_block_size / block_unit;
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Process-shared free lists need lock-free 64-bit atomics");
+
+    // Creates a new region, anonymous when name is nullptr
+    SharedBlockAllocator(size_t regionSize, size_t chunkSize = 16 * 1024, const char* name = nullptr);
+
+    // Maps a region created by another SharedBlockAllocator, the handle is closed on destruction when ownsHandle is set
+    SharedBlockAllocator(SharedMemoryHandle handle, bool ownsHandle);
+    ~SharedBlockAllocator();
+
+    SharedBlockAllocator(const SharedBlockAllocator&) = delete;
+    SharedBlockAllocator& operator=(const SharedBlockAllocator&) = delete;
+
+    // Returns nullptr once the region is full, or for sizes over max_block_size
+    virtual void* Allocate(size_t size) override;
+    virtual void Free(void* p, size_t size) override;
+
+    // Resets the whole region. No other process may use it at the time
+    virtual void Clear() override;
+
+    // Pointers are passed between processes as offsets
+    size_t GetOffset(const void* p) const;
+    void* GetPointer(size_t offset) const;
+
+    SharedMemoryHandle GetHandle() const;
+    size_t GetRegionSize() const;
+
+    // Counted over all processes
+    size_t GetBlockCount() const;
+    size_t GetChunkCount() const;
+
+private:
+    struct Header
+    {
+        uint64_t magic;
+        uint64_t regionSize;
+        uint64_t chunkSize;
+
+        std::atomic<uint64_t> top;
+        std::atomic<uint64_t> blockCount;
+        std::atomic<uint64_t> chunkCount;
+
+        // Tag in the upper 32 bits, offset in block units in the lower 32 bits. Zero offset ends the list
+        std::atomic<uint64_t> freeList[block_size_count];
+    };
+
+    static constexpr inline uint64_t header_magic = 0x53414c4c4f43534dull; // "SALLOCSM"
+    static constexpr inline size_t header_size = (sizeof(Header) + 63) & ~size_t(63);
+
+    static uint64_t Pack(uint64_t tag, uint64_t offset);
+
+    void Push(size_t index, uint64_t first, Block* last);
+
+    SharedMemoryHandle handle;
+    bool ownsHandle;
+
+    char* base;
+    Header* header;
+};
+
+inline uint64_t SharedBlockAllocator::Pack(uint64_t tag, uint64_t offset)
+{
+    return (tag << 32) | (offset / block_unit);
+}
+
+inline size_t SharedBlockAllocator::GetOffset(const void* p) const
+{
+    return (const char*)p - base;
+}
+
+inline void* SharedBlockAllocator::GetPointer(size_t offset) const
+{
+    return base + offset;
+}
+
+inline SharedMemoryHandle SharedBlockAllocator::GetHandle() const
+{
+    return handle;
+}
+
+inline size_t SharedBlockAllocator::GetRegionSize() const
+{
+    return header->regionSize;
+}
+
+inline size_t SharedBlockAllocator::GetBlockCount() const
+{
+    return header->blockCount.load(std::memory_order_relaxed);
+}
+
+inline size_t SharedBlockAllocator::GetChunkCount() const
+{
+    return header->chunkCount.load(std::memory_order_relaxed);
+}
+
+} // namespace salloc
@@ -18,6 +18,9 @@ public:
     virtual void Free(void* p, size_t size) override;
     virtual void Clear() override;
 
+    // Extends or shrinks the top allocation in place
+    virtual void* Reallocate(void* p, size_t oldSize, size_t newSize) override;
+
     size_t GetAllocation() const;
     size_t GetMaxAllocation() const;
 
@@ -46,12 +49,16 @@ StackAllocator<stackSize, maxStackEntries>::StackAllocator()
     , maxAllocation{ 0 }
     , entryCount{ 0 }
 {
+    sallocPoison(stack, stackSize);
 }
 
 template <size_t stackSize, size_t maxStackEntries>
 StackAllocator<stackSize, maxStackEntries>::~StackAllocator()
 {
     assert(index == 0 && entryCount == 0);
+
+    // The stack memory is handed back to its owner
+    sallocUnpoison(stack, stackSize);
 }
 
 template <size_t stackSize, size_t maxStackEntries>
@@ -62,16 +69,18 @@ void* StackAllocator<stackSize, maxStackEntries>::Allocate(size_t size)
     StackEntry* entry = entries + entryCount;
     entry->size = size;
 
-    if (index + size > stackSize)
+    if (index + size + redzone_size > stackSize)
     {
         entry->data = (char*)salloc::Alloc(size);
         entry->mallocUsed = true;
     }
     else
     {
+        // The redzone after the allocation stays poisoned
         entry->data = stack + index;
         entry->mallocUsed = false;
-        index += size;
+        index += size + redzone_size;
+        sallocUnpoison(entry->data, size);
     }
 
     allocation += size;
@@ -101,7 +110,8 @@ void StackAllocator<stackSize, maxStackEntries>::Free(void* p, size_t size)
     }
     else
     {
-        index -= entry->size;
+        index -= entry->size + redzone_size;
+        sallocPoison(p, entry->size);
     }
 
     allocation -= entry->size;
@@ -113,12 +123,73 @@ void StackAllocator<stackSize, maxStackEntries>::Free(void* p, size_t size)
 template <size_t stackSize, size_t maxStackEntries>
 void StackAllocator<stackSize, maxStackEntries>::Clear()
 {
+    sallocPoison(stack, stackSize);
+
     index = 0;
     allocation = 0;
     maxAllocation = 0;
     entryCount = 0;
 }
 
+template <size_t stackSize, size_t maxStackEntries>
+void* StackAllocator<stackSize, maxStackEntries>::Reallocate(void* p, size_t oldSize, size_t newSize)
+{
+    if (p == nullptr || newSize == 0)
+    {
+        return Allocator::Reallocate(p, oldSize, newSize);
+    }
+
+    assert(entryCount > 0);
+
+    // Only the top allocation can be resized
+    StackEntry* entry = entries + (entryCount - 1);
+    assert(entry->data == p);
+    assert(entry->size == oldSize);
+
+    if (entry->mallocUsed)
+    {
+        // Leaves the allocation as it is on failure
+        char* data = (char*)salloc::Realloc(p, newSize);
+        if (data == nullptr)
+        {
+            return nullptr;
+        }
+
+        entry->data = data;
+    }
+    else if (index - oldSize + newSize <= stackSize)
+    {
+        index = index - oldSize + newSize;
+        sallocPoison(p, oldSize + redzone_size);
+        sallocUnpoison(p, newSize);
+    }
+    else
+    {
+        // Move out to the upstream allocator
+        char* data = (char*)salloc::Alloc(newSize);
+        if (data == nullptr)
+        {
+            return nullptr;
+        }
+
+        entry->data = data;
+        entry->mallocUsed = true;
+        memcpy(entry->data, p, oldSize);
+        index -= oldSize + redzone_size;
+        sallocPoison(p, oldSize);
+    }
+
+    entry->size = newSize;
+
+    allocation = allocation - oldSize + newSize;
+    if (allocation > maxAllocation)
+    {
+        maxAllocation = allocation;
+    }
+
+    return entry->data;
+}
+
 template <size_t stackSize, size_t maxStackEntries>
 size_t StackAllocator<stackSize, maxStackEntries>::GetAllocation() const
 {
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "allocator.h"
+#include "virtual_memory.h"
+
+#if defined(SALLOC_HARDENED)
+#include "hardening.h"
+#endif
+
+#include <array>
+#include <cstdint>
+
+namespace salloc
+{
+
+// Predefined block allocator with the block sizes fixed at compile time.
+// The size map is a constexpr table and the free lists are stored inline,
+// so construction allocates nothing and the hot path loads no heap pointers
+template <size_t... blockSizes>
+class StaticPredefinedBlockAllocator : public Allocator
+{
+public:
+    static constexpr inline size_t block_size_count = sizeof...(blockSizes);
+    static constexpr inline std::array<size_t, block_size_count> block_sizes = { blockSizes... };
+    static constexpr inline size_t max_block_size = block_sizes[block_size_count - 1];
+
+    static_assert(block_size_count > 0 && block_size_count <= UINT8_MAX);
+
+    StaticPredefinedBlockAllocator(size_t initialChunkSize = 16 * 1024);
+    ~StaticPredefinedBlockAllocator();
+
+    virtual void* Allocate(size_t size) override;
+    virtual void Free(void* p, size_t size) override;
+    virtual void Clear() override;
+
+    virtual void* Reallocate(void* p, size_t oldSize, size_t newSize) override;
+
+    size_t GetBlockCount() const;
+    size_t GetChunkCount() const;
+    size_t GetChunkSize(size_t size) const;
+
+    static constexpr size_t GetBlockSizeIndex(size_t size);
+
+private:
+    static constexpr bool IsSorted();
+    static constexpr std::array<uint8_t, max_block_size + 1> MakeSizeMap();
+
+    static_assert(IsSorted(), "Block sizes must be ascending");
+    static_assert(block_sizes[0] >= sizeof(Block), "Block sizes must be at least sizeof(Block) to hold the free list link");
+
+    // Maps a size to the index of the smallest block size that fits it
+    static constexpr inline std::array<uint8_t, max_block_size + 1> size_map = MakeSizeMap();
+
+    size_t blockCount;
+    size_t chunkCount;
+
+    // Number of blocks in the last chunk of each size class
+    size_t blockCapacities[block_size_count];
+    Chunk* chunks;
+    Block* freeList[block_size_count];
+
+#if defined(SALLOC_HARDENED)
+    FreeListGuard guard;
+#endif
+};
+
+template <size_t... blockSizes>
+StaticPredefinedBlockAllocator<blockSizes...>::StaticPredefinedBlockAllocator(size_t initialChunkSize)
+    : blockCount{ 0 }
+    , chunkCount{ 0 }
+    , chunks{ nullptr }
+    , freeList{}
+{
+    // Every size class starts with the same chunk size
+    for (size_t i = 0; i < block_size_count; ++i)
+    {
+        blockCapacities[i] = initialChunkSize / block_sizes[i];
+        if (blockCapacities[i] == 0)
+        {
+            blockCapacities[i] = 1;
+        }
+    }
+}
+
+template <size_t... blockSizes>
+StaticPredefinedBlockAllocator<blockSizes...>::~StaticPredefinedBlockAllocator()
+{
+    Clear();
+}
+
+template <size_t... blockSizes>
+void* StaticPredefinedBlockAllocator<blockSizes...>::Allocate(size_t size)
+{
+    if (size == 0)
+    {
+        return nullptr;
+    }
+    if (size > max_block_size)
+    {
+        return salloc::Alloc(size);
+    }
+
+    size_t index = size_map[size];
+    size_t blockSize = block_sizes[index];
+
+    if (freeList[index] == nullptr)
+    {
+        sallocInstrumentScope(InstrumentEvent::refill, blockSize);
+
+        // Grow the chunk of this size class by half, rounded up to whole pages
+        blockCapacities[index] += blockCapacities[index] / 2;
+        size_t chunkSize = RoundUpToPage(blockCapacities[index] * blockSize);
+        size_t blockCapacity = chunkSize / blockSize;
+        blockCapacities[index] = blockCapacity;
+
+        Block* blocks = (Block*)salloc::Alloc(chunkSize);
+
+#if defined(SALLOC_HARDENED)
+        Block* head = guard.AddChunk(blocks, blockSize, blockCapacity);
+#else
+        // Build a linked list for the free list.
+        for (size_t i = 0; i < blockCapacity - 1; ++i)
+        {
+            Block* block = (Block*)((char*)blocks + blockSize * i);
+            Block* next = (Block*)((char*)blocks + blockSize * (i + 1));
+            block->next = next;
+        }
+        Block* last = (Block*)((char*)blocks + blockSize * (blockCapacity - 1));
+        last->next = nullptr;
+
+        Block* head = blocks;
+#endif
+
+        // Free blocks stay poisoned until allocated
+        sallocPoison(blocks, blockCapacity * blockSize);
+
+        Chunk* newChunk = (Chunk*)salloc::Alloc(sizeof(Chunk));
+        newChunk->capacity = blockCapacity;
+        newChunk->blockSize = blockSize;
+        newChunk->blocks = blocks;
+        newChunk->next = chunks;
+        chunks = newChunk;
+        ++chunkCount;
+
+        freeList[index] = head;
+    }
+    else
+    {
+        sallocInstrumentCount(InstrumentEvent::free_list_pop, blockSize);
+    }
+
+    Block* block = freeList[index];
+    sallocUnpoison(block, sizeof(Block));
+#if defined(SALLOC_HARDENED)
+    freeList[index] = guard.Pop(block, blockSize);
+#else
+    freeList[index] = block->next;
+#endif
+    // Slack after the requested size stays poisoned
+    sallocPoison(block, blockSize);
+    sallocUnpoison(block, size);
+    ++blockCount;
+
+    return block;
+}
+
+template <size_t... blockSizes>
+void StaticPredefinedBlockAllocator<blockSizes...>::Free(void* p, size_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    if (size > max_block_size)
+    {
+        salloc::Free(p);
+        return;
+    }
+
+    size_t index = size_map[size];
+    size_t blockSize = block_sizes[index];
+
+#if defined(_DEBUG)
+    // Verify the memory address and size is valid.
+    bool found = false;
+
+    Chunk* chunk = chunks;
+    while (chunk)
+    {
+        if (chunk->blockSize == blockSize && (char*)chunk->blocks <= (char*)p &&
+            (char*)p + blockSize <= (char*)chunk->blocks + chunk->blockSize * chunk->capacity)
+        {
+            found = true;
+            break;
+        }
+
+        chunk = chunk->next;
+    }
+
+    assert(found);
+#endif
+
+    Block* block = (Block*)p;
+    sallocUnpoison(block, sizeof(Block));
+#if defined(SALLOC_HARDENED)
+    guard.Push(block, freeList[index], blockSize);
+#else
+    block->next = freeList[index];
+#endif
+    sallocPoison(block, blockSize);
+    freeList[index] = block;
+    --blockCount;
+}
+
+template <size_t... blockSizes>
+void StaticPredefinedBlockAllocator<blockSizes...>::Clear()
+{
+    sallocInstrumentScope(InstrumentEvent::clear, 0);
+
+    Chunk* chunk = chunks;
+    while (chunk)
+    {
+        Chunk* c0 = chunk;
+        chunk = c0->next;
+        sallocUnpoison(c0->blocks, c0->capacity * c0->blockSize);
+        salloc::Free(c0->blocks);
+        salloc::Free(c0);
+    }
+
+    blockCount = 0;
+    chunkCount = 0;
+    chunks = nullptr;
+    memset(freeList, 0, sizeof(freeList));
+
+#if defined(SALLOC_HARDENED)
+    guard.Clear();
+#endif
+}
+
+template <size_t... blockSizes>
+void* StaticPredefinedBlockAllocator<blockSizes...>::Reallocate(void* p, size_t oldSize, size_t newSize)
+{
+    if (p == nullptr || newSize == 0 || oldSize == 0)
+    {
+        return Allocator::Reallocate(p, oldSize, newSize);
+    }
+
+    if (oldSize > max_block_size && newSize > max_block_size)
+    {
+        return salloc::Realloc(p, newSize);
+    }
+
+    // Still fits in the same block size class
+    if (oldSize <= max_block_size && newSize <= max_block_size && size_map[oldSize] == size_map[newSize])
+    {
+        sallocPoison(p, oldSize);
+        sallocUnpoison(p, newSize);
+        return p;
+    }
+
+    return Allocator::Reallocate(p, oldSize, newSize);
+}
+
+template <size_t... blockSizes>
+size_t StaticPredefinedBlockAllocator<blockSizes...>::GetBlockCount() const
+{
+    return blockCount;
+}
+
+template <size_t... blockSizes>
+size_t StaticPredefinedBlockAllocator<blockSizes...>::GetChunkCount() const
+{
+    return chunkCount;
+}
+
+template <size_t... blockSizes>
+size_t StaticPredefinedBlockAllocator<blockSizes...>::GetChunkSize(size_t size) const
+{
+    assert(0 < size && size <= max_block_size);
+
+    size_t index = size_map[size];
+    return blockCapacities[index] * block_sizes[index];
+}
+
+template <size_t... blockSizes>
+constexpr size_t StaticPredefinedBlockAllocator<blockSizes...>::GetBlockSizeIndex(size_t size)
+{
+    return size_map[size];
+}
+
+template <size_t... blockSizes>
+constexpr bool StaticPredefinedBlockAllocator<blockSizes...>::IsSorted()
+{
+    for (size_t i = 1; i < block_size_count; ++i)
+    {
+        if (block_sizes[i - 1] >= block_sizes[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <size_t... blockSizes>
+constexpr std::array<uint8_t, StaticPredefinedBlockAllocator<blockSizes...>::max_block_size + 1>
+StaticPredefinedBlockAllocator<blockSizes...>::MakeSizeMap()
+{
+    std::array<uint8_t, max_block_size + 1> map{};
+
+    size_t j = 0;
+    for (size_t i = 1; i <= max_block_size; ++i)
+    {
+        if (i > block_sizes[j])
+        {
+            ++j;
+        }
+        map[i] = (uint8_t)j;
+    }
+
+    return map;
+}
+
+} // namespace salloc
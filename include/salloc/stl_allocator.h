@@ -0,0 +1,147 @@
+#pragma once
+
+#include "allocator.h"
+
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace salloc
+{
+
+// Adaptor meeting the C++ Allocator requirements, so standard containers draw from a Salloc allocator.
+// Carries a reference to the allocator, which rebinding keeps, and frees with the size of the allocation.
+// Calls go straight to AllocatorType, skipping the virtual dispatch unless AllocatorType is the Allocator interface itself.
+// Single object allocations go to AllocateNode/FreeNode when AllocatorType has them, see NodePoolResource.
+// Sizes are rounded up to 8 bytes, so bump allocators like LinearAllocator keep every allocation aligned
+template <typename T, typename AllocatorType = Allocator>
+class StlAllocator
+{
+public:
+    static constexpr inline size_t alignment = 8;
+
+    static_assert(alignof(T) <= alignment, "Salloc allocators align to 8 bytes");
+
+    using value_type = T;
+
+    // Containers keep drawing from the same allocator they were given
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = StlAllocator<U, AllocatorType>;
+    };
+
+    StlAllocator(AllocatorType& allocator) noexcept;
+
+    template <typename U>
+    StlAllocator(const StlAllocator<U, AllocatorType>& other) noexcept;
+
+    T* allocate(size_t n);
+    void deallocate(T* p, size_t n) noexcept;
+
+    AllocatorType& GetAllocator() const noexcept;
+
+    template <typename U>
+    bool operator==(const StlAllocator<U, AllocatorType>& other) const noexcept;
+
+private:
+    static constexpr size_t GetSize(size_t n);
+
+    static constexpr inline bool is_interface = std::is_same_v<AllocatorType, Allocator>;
+    static constexpr inline bool has_node_pool = requires(AllocatorType& a, void* p) {
+        a.AllocateNode(size_t(0));
+        a.FreeNode(p, size_t(0));
+    };
+
+    AllocatorType* allocator;
+};
+
+template <typename T, typename AllocatorType>
+StlAllocator<T, AllocatorType>::StlAllocator(AllocatorType& allocator) noexcept
+    : allocator{ &allocator }
+{
+}
+
+template <typename T, typename AllocatorType>
+template <typename U>
+StlAllocator<T, AllocatorType>::StlAllocator(const StlAllocator<U, AllocatorType>& other) noexcept
+    : allocator{ &other.GetAllocator() }
+{
+}
+
+template <typename T, typename AllocatorType>
+T* StlAllocator<T, AllocatorType>::allocate(size_t n)
+{
+    void* p;
+    if constexpr (has_node_pool)
+    {
+        p = n == 1 ? allocator->AllocateNode(GetSize(1)) : allocator->AllocatorType::Allocate(GetSize(n));
+    }
+    else if constexpr (is_interface)
+    {
+        p = allocator->Allocate(GetSize(n));
+    }
+    else
+    {
+        p = allocator->AllocatorType::Allocate(GetSize(n));
+    }
+
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    assert((uintptr_t)p % alignof(T) == 0);
+
+    return (T*)p;
+}
+
+template <typename T, typename AllocatorType>
+void StlAllocator<T, AllocatorType>::deallocate(T* p, size_t n) noexcept
+{
+    if constexpr (has_node_pool)
+    {
+        if (n == 1)
+        {
+            allocator->FreeNode(p, GetSize(1));
+        }
+        else
+        {
+            allocator->AllocatorType::Free(p, GetSize(n));
+        }
+    }
+    else if constexpr (is_interface)
+    {
+        allocator->Free(p, GetSize(n));
+    }
+    else
+    {
+        allocator->AllocatorType::Free(p, GetSize(n));
+    }
+}
+
+template <typename T, typename AllocatorType>
+constexpr size_t StlAllocator<T, AllocatorType>::GetSize(size_t n)
+{
+    return (n * sizeof(T) + alignment - 1) & ~(alignment - 1);
+}
+
+template <typename T, typename AllocatorType>
+AllocatorType& StlAllocator<T, AllocatorType>::GetAllocator() const noexcept
+{
+    return *allocator;
+}
+
+template <typename T, typename AllocatorType>
+template <typename U>
+bool StlAllocator<T, AllocatorType>::operator==(const StlAllocator<U, AllocatorType>& other) const noexcept
+{
+    return allocator == &other.GetAllocator();
+}
+
+} // namespace salloc
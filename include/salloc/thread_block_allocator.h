@@ -0,0 +1,105 @@
+#pragma once
+
+#include "allocator.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace salloc
+{
+
+// Block allocator owned by a single thread, whose blocks may be freed from any thread.
+// Each thread calls Allocate and Free on its own instance. Blocks are carved from segment_size aligned segments
+// tagged with their owner, so the owner of a pointer is found by masking its address.
+// Blocks owned by another allocator are pushed onto the owner's lock-free remote free list,
+// which the owner drains in a batch on its next refill.
+// An allocator may be destroyed while other threads still hold its blocks. Its segments are then orphaned,
+// and the last of those blocks to be freed releases them. Clear requires every block to be back
+class ThreadBlockAllocator : public Allocator
+{
+public:
+    static constexpr inline size_t max_block_size = 1024;
+    static constexpr inline size_t block_unit = 8;
+    static constexpr inline size_t block_size_count = max_block_size / block_unit;
+
+    static constexpr inline size_t segment_size = 64 * 1024;
+
+    ThreadBlockAllocator();
+    ~ThreadBlockAllocator();
+
+    ThreadBlockAllocator(const ThreadBlockAllocator&) = delete;
+    ThreadBlockAllocator& operator=(const ThreadBlockAllocator&) = delete;
+
+    virtual void* Allocate(size_t size) override;
+    virtual void Free(void* p, size_t size) override;
+    virtual void Clear() override;
+
+    // Moves blocks freed by other threads back to the free lists
+    void Collect();
+
+    // Returns the allocator owning the block, nullptr once the owner is destroyed
+    static ThreadBlockAllocator* GetOwner(const void* p);
+
+    size_t GetBlockCount() const;
+    size_t GetSegmentCount() const;
+
+private:
+    struct Segment;
+
+    // Outlives the allocator while other threads still hold its blocks
+    struct SharedState
+    {
+        // Multi-producer single-consumer stack of blocks freed by other threads, closed once the owner is destroyed
+        std::atomic<Block*> remoteFreeList;
+
+        // Blocks still out after the owner is destroyed, and the segments they keep alive
+        std::atomic<size_t> orphanCount;
+        Segment* segments;
+    };
+
+    struct Segment
+    {
+        std::atomic<ThreadBlockAllocator*> owner;
+        SharedState* shared;
+        size_t blockSize;
+        Segment* next;
+    };
+
+    static constexpr inline size_t segment_header_size = (sizeof(Segment) + 15) & ~size_t(15);
+
+    static Segment* GetSegment(const void* p);
+
+    // Frees the segments once the last orphaned block is back
+    static void ReleaseOrphans(SharedState* shared, size_t count);
+    static void FreeSegments(Segment* segment);
+
+    size_t blockCount;
+    size_t segmentCount;
+
+    Segment* segments;
+    Block* freeList[block_size_count];
+
+    SharedState* shared;
+};
+
+inline ThreadBlockAllocator::Segment* ThreadBlockAllocator::GetSegment(const void* p)
+{
+    return (Segment*)((uintptr_t)p & ~(uintptr_t)(segment_size - 1));
+}
+
+inline ThreadBlockAllocator* ThreadBlockAllocator::GetOwner(const void* p)
+{
+    return GetSegment(p)->owner.load(std::memory_order_relaxed);
+}
+
+inline size_t ThreadBlockAllocator::GetBlockCount() const
+{
+    return blockCount;
+}
+
+inline size_t ThreadBlockAllocator::GetSegmentCount() const
+{
+    return segmentCount;
+}
+
+} // namespace salloc
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "allocator.h"
+
+#include <cstdint>
+
+namespace salloc
+{
+
+// Two-Level Segregated Fit allocator for variable sized allocations freed in any order.
+// Free blocks are kept in segregated lists indexed by a power of two range and a linear subdivision of it,
+// found in O(1) through two levels of bitmaps. Freed blocks merge with free physical neighbours right away.
+// Works over a caller provided region, or grows by adding pools from the upstream allocator
+class TlsfAllocator : public Allocator
+{
+public:
+    static constexpr inline size_t align_size = 16;
+
+    // Each first level range is split into 32 second level lists
+    static constexpr inline size_t sl_index_count_log2 = 5;
+    static constexpr inline size_t sl_index_count = 1 << sl_index_count_log2;
+
+    // Sizes below small_block_size share the first level list
+    static constexpr inline size_t fl_index_shift = sl_index_count_log2 + 4;
+    static constexpr inline size_t small_block_size = 1 << fl_index_shift;
+    static constexpr inline size_t fl_index_max = 32;
+    static constexpr inline size_t fl_index_count = fl_index_max - fl_index_shift + 1;
+
+    static constexpr inline size_t max_block_size = size_t(1) << fl_index_max;
+
+    // Keeps the block spanning a pool below max_block_size, larger regions are split into several pools
+    static constexpr inline size_t max_pool_size = max_block_size;
+
+    // Growable, pools are taken from the upstream allocator
+    TlsfAllocator(size_t initialPoolSize = 1024 * 1024);
+
+    // Fixed, manages the given memory only
+    TlsfAllocator(void* memory, size_t size);
+    ~TlsfAllocator();
+
+    TlsfAllocator(const TlsfAllocator&) = delete;
+    TlsfAllocator& operator=(const TlsfAllocator&) = delete;
+
+    // Returns nullptr when a fixed region has no block large enough
+    virtual void* Allocate(size_t size) override;
+    virtual void Free(void* p, size_t size) override;
+    virtual void Clear() override;
+
+    // Grows into a free physical neighbour in place where possible
+    virtual void* Reallocate(void* p, size_t oldSize, size_t newSize) override;
+
+    size_t GetPoolCount() const;
+    size_t GetBlockCount() const;
+    size_t GetFreeSize() const;
+
+private:
+    struct BlockHeader
+    {
+        BlockHeader* prevPhysical;
+
+        // Payload size, the lowest bit marks the block free
+        size_t size;
+
+        // Inside the payload, only while the block is free
+        BlockHeader* nextFree;
+        BlockHeader* prevFree;
+    };
+
+    struct Pool
+    {
+        Pool* next;
+        size_t size;
+    };
+
+    static constexpr inline size_t block_header_size = 2 * sizeof(void*);
+    static constexpr inline size_t pool_header_size = (sizeof(Pool) + align_size - 1) & ~(align_size - 1);
+    static constexpr inline size_t min_block_size = sizeof(BlockHeader) - block_header_size;
+    static constexpr inline size_t free_bit = 1;
+
+    static_assert(block_header_size % align_size == 0 || align_size % block_header_size == 0);
+
+    static size_t GetSize(const BlockHeader* block);
+    static bool IsFree(const BlockHeader* block);
+    static char* GetPayload(const BlockHeader* block);
+    static BlockHeader* GetBlock(const void* payload);
+    static BlockHeader* GetNextPhysical(const BlockHeader* block);
+
+    // First and second level index of the list holding blocks of the size
+    static void Mapping(size_t size, size_t* fl, size_t* sl);
+
+    BlockHeader* FindFreeBlock(size_t size);
+    void InsertFreeBlock(BlockHeader* block);
+    void RemoveFreeBlock(BlockHeader* block);
+
+    // Splits off the part of the block past size as a new free block
+    void Split(BlockHeader* block, size_t size);
+    BlockHeader* Merge(BlockHeader* block);
+
+    void AddPool(void* memory, size_t size);
+    void ResetPool(Pool* pool);
+
+    bool growable;
+    size_t poolSize;
+
+    size_t poolCount;
+    size_t blockCount;
+    size_t freeSize;
+
+    Pool* pools;
+
+    uint32_t flBitmap;
+    uint32_t slBitmap[fl_index_count];
+    BlockHeader* freeLists[fl_index_count][sl_index_count];
+};
+
+inline size_t TlsfAllocator::GetPoolCount() const
+{
+    return poolCount;
+}
+
+inline size_t TlsfAllocator::GetBlockCount() const
+{
+    return blockCount;
+}
+
+inline size_t TlsfAllocator::GetFreeSize() const
+{
+    return freeSize;
+}
+
+inline size_t TlsfAllocator::GetSize(const BlockHeader* block)
+{
+    return block->size & ~free_bit;
+}
+
+inline bool TlsfAllocator::IsFree(const BlockHeader* block)
+{
+    return (block->size & free_bit) != 0;
+}
+
+inline char* TlsfAllocator::GetPayload(const BlockHeader* block)
+{
+    return (char*)block + block_header_size;
+}
+
+inline TlsfAllocator::BlockHeader* TlsfAllocator::GetBlock(const void* payload)
+{
+    return (BlockHeader*)((char*)payload - block_header_size);
+}
+
+inline TlsfAllocator::BlockHeader* TlsfAllocator::GetNextPhysical(const BlockHeader* block)
+{
+    return (BlockHeader*)(GetPayload(block) + GetSize(block));
+}
+
+} // namespace salloc
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "allocator.h"
+
+#include <cstdint>
+
+namespace salloc
+{
+
+// Thin wrappers over the OS virtual memory API.
+// Sizes and addresses passed to these must be page aligned
+
+size_t GetPageSize();
+
+// Alignment of mapping addresses, larger than the page size on Windows
+size_t GetAllocationGranularity();
+
+// Reserve address space without backing memory
+void* ReserveMemory(size_t size);
+void ReleaseMemory(void* p, size_t size);
+
+// Back the reserved pages with readable, writable memory
+bool CommitMemory(void* p, size_t size);
+void DecommitMemory(void* p, size_t size);
+
+// Keep the pages resident in RAM. Fails when the process is over its locked memory limit
+bool LockMemory(void* p, size_t size);
+void UnlockMemory(void* p, size_t size);
+
+// Place pages of the range on the given NUMA node. Returns false where not supported
+bool BindMemory(void* p, size_t size, size_t node);
+
+// Shared memory objects are identified by a file descriptor, or a HANDLE on Windows
+using SharedMemoryHandle = intptr_t;
+constexpr inline SharedMemoryHandle invalid_shared_memory = -1;
+
+// Anonymous when name is nullptr, otherwise other processes can open the object by name.
+// Anonymous objects are shared by passing the handle to a child process or over a socket
+SharedMemoryHandle CreateSharedMemory(size_t size, const char* name = nullptr);
+SharedMemoryHandle OpenSharedMemory(const char* name);
+void CloseSharedMemory(SharedMemoryHandle handle);
+
+// Removes the name, the object lives on until every handle and mapping is gone. No-op on Windows
+void UnlinkSharedMemory(const char* name);
+
+void* MapSharedMemory(SharedMemoryHandle handle, size_t size);
+void UnmapSharedMemory(void* p, size_t size);
+
+// Maps the same size bytes twice back to back, so accesses running past the end wrap around to the start.
+// Size must be a multiple of the allocation granularity
+void* MapMirroredMemory(size_t size);
+void UnmapMirroredMemory(void* p, size_t size);
+
+// Maps the first size bytes of the file at the page aligned address p, replacing the pages there.
+// Writes stay private to the process. Falls back to reading the file where mapping isn't supported
+bool MapFile(const char* path, void* p, size_t size);
+
+inline size_t RoundUpToPage(size_t size)
+{
+    size_t pageSize = GetPageSize();
+    return (size + pageSize - 1) / pageSize * pageSize;
+}
+
+} // namespace salloc
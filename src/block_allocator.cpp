@@ -1,5 +1,7 @@
 #include "salloc/block_allocator.h"
 
+#include <algorithm>
+
 namespace salloc
 {
 
@@ -7,17 +9,35 @@ BlockAllocator::BlockAllocator(size_t initialChunkSize)
     : blockCount{ 0 }
     , chunkCount{ 0 }
     , chunks{ nullptr }
+    , refillRunning{ false }
+    , initialChunkSize{ initialChunkSize }
+    , budget{ nullptr }
+    , onExhausted{ nullptr }
 {
     memset(freeList, 0, sizeof(freeList));
+    memset(lineChunks, 0, sizeof(lineChunks));
+    memset(lineFreeList, 0, sizeof(lineFreeList));
 
     for (size_t i = 0; i < block_size_count; ++i)
     {
         chunkSizes[i] = initialChunkSize;
+        freeCounts[i].store(0, std::memory_order_relaxed);
+        watermarks[i].store(0, std::memory_order_relaxed);
+        lastChunkSizes[i].store(0, std::memory_order_relaxed);
+        readyChunks[i].store(nullptr, std::memory_order_relaxed);
     }
 }
 
+BlockAllocator::BlockAllocator(RealtimeBudget& budget, size_t initialChunkSize, ExhaustionHandler onExhausted)
+    : BlockAllocator(initialChunkSize)
+{
+    this->budget = &budget;
+    this->onExhausted = onExhausted;
+}
+
 BlockAllocator::~BlockAllocator()
 {
+    StopBackgroundRefill();
     Clear();
 }
 
@@ -29,6 +49,10 @@ void* BlockAllocator::Allocate(size_t size)
     }
     if (size > max_block_size)
     {
+        if (budget)
+        {
+            return ReportExhaustion(onExhausted, size);
+        }
         return salloc::Alloc(size);
     }
 
@@ -46,42 +70,40 @@ void* BlockAllocator::Allocate(size_t size)
         --index;
     }
 
-    assert(0 <= index && index <= block_size_count);
+    assert(index <= block_size_count);
 
     if (freeList[index] == nullptr)
     {
-        // Increase chunk size by half
-        chunkSizes[index] += chunkSizes[index] / 2;
-
-        size_t chunkSize = chunkSizes[index];
-        size_t blockCapacity = chunkSize / blockSize;
+        sallocInstrumentScope(InstrumentEvent::refill, blockSize);
 
-        Block* blocks = (Block*)salloc::Alloc(chunkSize);
-
-        // Build a linked list for the free list.
-        for (size_t i = 0; i < blockCapacity - 1; ++i)
+        // Take the chunk prepared by the refill thread if there is one
+        Chunk* ready = readyChunks[index].exchange(nullptr, std::memory_order_acquire);
+        if (ready)
         {
-            Block* block = (Block*)((char*)blocks + blockSize * i);
-            Block* next = (Block*)((char*)blocks + blockSize * (i + 1));
-            block->next = next;
+            SpliceChunk(index, ready);
         }
-        Block* last = (Block*)((char*)blocks + blockSize * (blockCapacity - 1));
-        last->next = nullptr;
-
-        Chunk* newChunk = (Chunk*)salloc::Alloc(sizeof(Chunk));
-        newChunk->capacity = blockCapacity;
-        newChunk->blockSize = blockSize;
-        newChunk->blocks = blocks;
-        newChunk->next = chunks;
-        chunks = newChunk;
-        ++chunkCount;
-
-        freeList[index] = newChunk->blocks;
+        else if (!CreateChunk(index, 1))
+        {
+            return ReportExhaustion(onExhausted, size);
+        }
+    }
+    else
+    {
+        sallocInstrumentCount(InstrumentEvent::free_list_pop, blockSize);
     }
 
     Block* block = freeList[index];
+    sallocUnpoison(block, sizeof(Block));
+#if defined(SALLOC_HARDENED)
+    freeList[index] = guard.Pop(block, blockSize);
+#else
     freeList[index] = block->next;
+#endif
+    // Slack after the requested size stays poisoned
+    sallocPoison(block, blockSize);
+    sallocUnpoison(block, size);
     ++blockCount;
+    freeCounts[index].store(freeCounts[index].load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
 
     return block;
 }
@@ -95,7 +117,11 @@ void BlockAllocator::Free(void* p, size_t size)
 
     if (size > max_block_size)
     {
-        salloc::Free(p);
+        // Never handed out in realtime mode
+        if (budget == nullptr)
+        {
+            salloc::Free(p);
+        }
         return;
     }
 
@@ -111,7 +137,7 @@ void BlockAllocator::Free(void* p, size_t size)
         --index;
     }
 
-    assert(0 <= index && index <= block_size_count);
+    assert(index <= block_size_count);
 
 #if defined(_DEBUG)
     // Verify the memory address and size is valid.
@@ -143,47 +169,532 @@ void BlockAllocator::Free(void* p, size_t size)
 #endif
 
     Block* block = (Block*)p;
+    sallocUnpoison(block, sizeof(Block));
+#if defined(SALLOC_HARDENED)
+    guard.Push(block, freeList[index], blockSize);
+#else
     block->next = freeList[index];
+#endif
+    sallocPoison(block, blockSize);
     freeList[index] = block;
     --blockCount;
+    freeCounts[index].store(freeCounts[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 }
 
 void BlockAllocator::Clear()
 {
+    sallocInstrumentScope(InstrumentEvent::clear, 0);
+
+    if (budget)
+    {
+        RecycleChunks();
+        return;
+    }
+
     Chunk* chunk = chunks;
     while (chunk)
     {
         Chunk* c0 = chunk;
         chunk = c0->next;
+        sallocUnpoison(c0->blocks, c0->capacity * c0->blockSize);
         salloc::Free(c0->blocks);
         salloc::Free(c0);
     }
 
+    for (size_t i = 0; i < 2; ++i)
+    {
+        chunk = lineChunks[i];
+        while (chunk)
+        {
+            Chunk* c0 = chunk;
+            chunk = c0->next;
+            sallocUnpoison(c0->blocks, c0->capacity * c0->blockSize);
+            salloc::AlignedFree(c0->blocks);
+            salloc::Free(c0);
+        }
+    }
+
+    DiscardReadyChunks();
+
     blockCount = 0;
     chunkCount = 0;
     chunks = nullptr;
     memset(freeList, 0, sizeof(freeList));
+    memset(lineChunks, 0, sizeof(lineChunks));
+    memset(lineFreeList, 0, sizeof(lineFreeList));
+
+#if defined(SALLOC_HARDENED)
+    guard.Clear();
+#endif
 }
 
-void BlockAllocator::Clear(size_t initialChunkSize)
+void BlockAllocator::Clear(size_t newInitialChunkSize)
 {
     Clear();
 
+    initialChunkSize = newInitialChunkSize;
+
     for (size_t i = 0; i < block_size_count; ++i)
     {
-        chunkSizes[i] = initialChunkSize;
+        chunkSizes[i] = newInitialChunkSize;
+    }
+}
+
+void* BlockAllocator::Reallocate(void* p, size_t oldSize, size_t newSize)
+{
+    if (p == nullptr || newSize == 0 || oldSize == 0)
+    {
+        return Allocator::Reallocate(p, oldSize, newSize);
+    }
+
+    if (oldSize > max_block_size && newSize > max_block_size)
+    {
+        return salloc::Realloc(p, newSize);
+    }
+
+    // Still fits in the same block size class
+    if (oldSize <= max_block_size && newSize <= max_block_size && (oldSize - 1) / block_unit == (newSize - 1) / block_unit)
+    {
+        sallocPoison(p, oldSize);
+        sallocUnpoison(p, newSize);
+        return p;
+    }
+
+    return Allocator::Reallocate(p, oldSize, newSize);
+}
+
+void* BlockAllocator::Allocate(size_t size, BlockPlacement placement)
+{
+    if (placement == BlockPlacement::packed || size == 0 || size > max_block_size)
+    {
+        return Allocate(size);
+    }
+
+    size_t index = (size - 1) / cache_line_size;
+    size_t stride = GetLineStride(size, placement);
+    Block** list = lineFreeList[(size_t)placement - 1] + index;
+
+    if (*list == nullptr)
+    {
+        size_t blockCapacity = initialChunkSize / stride;
+        if (blockCapacity == 0)
+        {
+            blockCapacity = 1;
+        }
+
+        Chunk* newChunk;
+        if (budget)
+        {
+            newChunk = budget->AllocateChunk(stride, blockCapacity, 1, cache_line_size);
+            if (newChunk == nullptr)
+            {
+                return ReportExhaustion(onExhausted, size);
+            }
+        }
+        else
+        {
+            newChunk = (Chunk*)salloc::Alloc(sizeof(Chunk));
+            newChunk->capacity = blockCapacity;
+            newChunk->blockSize = stride;
+            newChunk->blocks = (Block*)salloc::AlignedAlloc(blockCapacity * stride, cache_line_size);
+        }
+
+        Block* head = LinkBlocks(newChunk->blocks, stride, newChunk->capacity, nullptr);
+        sallocPoison(newChunk->blocks, newChunk->capacity * stride);
+
+        newChunk->next = lineChunks[(size_t)placement - 1];
+        lineChunks[(size_t)placement - 1] = newChunk;
+        ++chunkCount;
+
+        *list = head;
     }
+
+    Block* block = *list;
+    sallocUnpoison(block, sizeof(Block));
+#if defined(SALLOC_HARDENED)
+    *list = guard.Pop(block, stride);
+#else
+    *list = block->next;
+#endif
+    sallocPoison(block, stride);
+    sallocUnpoison(block, size);
+    ++blockCount;
+
+    return block;
+}
+
+void BlockAllocator::Free(void* p, size_t size, BlockPlacement placement)
+{
+    if (placement == BlockPlacement::packed || size == 0 || size > max_block_size)
+    {
+        Free(p, size);
+        return;
+    }
+
+    size_t index = (size - 1) / cache_line_size;
+    size_t stride = GetLineStride(size, placement);
+    Block** list = lineFreeList[(size_t)placement - 1] + index;
+
+#if defined(_DEBUG)
+    // Verify the memory address is valid.
+    bool found = false;
+
+    Chunk* chunk = lineChunks[(size_t)placement - 1];
+    while (chunk)
+    {
+        if ((char*)chunk->blocks <= (char*)p && (char*)p < (char*)chunk->blocks + chunk->capacity * chunk->blockSize)
+        {
+            found = true;
+            break;
+        }
+
+        chunk = chunk->next;
+    }
+
+    assert(found);
+#endif
+
+    Block* block = (Block*)p;
+    sallocUnpoison(block, sizeof(Block));
+#if defined(SALLOC_HARDENED)
+    guard.Push(block, *list, stride);
+#else
+    block->next = *list;
+#endif
+    sallocPoison(block, stride);
+    *list = block;
+    --blockCount;
+}
+
+size_t BlockAllocator::GetLineStride(size_t size, BlockPlacement placement)
+{
+    size_t stride = ((size - 1) / cache_line_size + 1) * cache_line_size;
+
+    // Isolated blocks are followed by an unused cache line
+    if (placement == BlockPlacement::cache_line_isolated)
+    {
+        stride += cache_line_size;
+    }
+
+    return stride;
 }
 
 size_t BlockAllocator::GetChunkSize(size_t size) const
 {
-    size_t index = size / block_unit;
-    if (size % block_unit == 0)
+    return chunkSizes[GetBlockSizeIndex(size)];
+}
+
+size_t BlockAllocator::GetFreeCount(size_t size) const
+{
+    return freeCounts[GetBlockSizeIndex(size)].load(std::memory_order_relaxed);
+}
+
+void BlockAllocator::Reserve(size_t size, size_t count)
+{
+    if (size == 0 || size > max_block_size)
     {
-        --index;
+        return;
+    }
+
+    size_t index = GetBlockSizeIndex(size);
+    size_t freeCount = freeCounts[index].load(std::memory_order_relaxed);
+    if (freeCount < count)
+    {
+        CreateChunk(index, count - freeCount);
+    }
+}
+
+void BlockAllocator::Prewarm(std::span<const Reservation> profile)
+{
+    for (const Reservation& reservation : profile)
+    {
+        Reserve(reservation.size, reservation.count);
+    }
+}
+
+void BlockAllocator::SetWatermark(size_t size, size_t count)
+{
+    watermarks[GetBlockSizeIndex(size)].store(count, std::memory_order_relaxed);
+}
+
+void BlockAllocator::Replenish()
+{
+    for (size_t i = 0; i < block_size_count; ++i)
+    {
+        size_t freeCount = freeCounts[i].load(std::memory_order_relaxed);
+        size_t watermark = watermarks[i].load(std::memory_order_relaxed);
+        if (freeCount < watermark)
+        {
+            CreateChunk(i, watermark - freeCount);
+        }
+    }
+}
+
+bool BlockAllocator::CreateChunk(size_t index, size_t minCapacity)
+{
+    size_t blockSize = (index + 1) * block_unit;
+
+    // Increase chunk size by half. Larger reservations get a chunk of their own and leave the growth as it is
+    size_t chunkSize = chunkSizes[index] + chunkSizes[index] / 2;
+    if (chunkSize < minCapacity * blockSize)
+    {
+        chunkSize = minCapacity * blockSize;
+    }
+    else
+    {
+        chunkSizes[index] = chunkSize;
+    }
+
+    size_t blockCapacity = chunkSize / blockSize;
+
+    Chunk* newChunk;
+    if (budget)
+    {
+        newChunk = budget->AllocateChunk(blockSize, blockCapacity, minCapacity);
+        if (newChunk == nullptr)
+        {
+            return false;
+        }
+        blockCapacity = newChunk->capacity;
+    }
+    else
+    {
+        newChunk = (Chunk*)salloc::Alloc(sizeof(Chunk));
+        newChunk->capacity = blockCapacity;
+        newChunk->blockSize = blockSize;
+        newChunk->blocks = (Block*)salloc::Alloc(chunkSize);
+    }
+
+    // Threading the free list writes to every block, which also faults in the pages of the chunk.
+    // Remaining free blocks of the size class are linked after the new ones
+    Block* head = LinkBlocks(newChunk->blocks, blockSize, blockCapacity, freeList[index]);
+
+    // Free blocks stay poisoned until allocated
+    sallocPoison(newChunk->blocks, blockCapacity * blockSize);
+
+    newChunk->next = chunks;
+    chunks = newChunk;
+    ++chunkCount;
+
+    freeList[index] = head;
+    freeCounts[index].store(freeCounts[index].load(std::memory_order_relaxed) + blockCapacity, std::memory_order_relaxed);
+    lastChunkSizes[index].store(chunkSizes[index], std::memory_order_relaxed);
+
+    return true;
+}
+
+Block* BlockAllocator::LinkBlocks(Block* blocks, size_t blockSize, size_t capacity, Block* tail)
+{
+#if defined(SALLOC_HARDENED)
+    return guard.AddChunk(blocks, blockSize, capacity, tail);
+#else
+    // Build a linked list for the free list.
+    for (size_t i = 0; i < capacity - 1; ++i)
+    {
+        Block* block = (Block*)((char*)blocks + blockSize * i);
+        Block* next = (Block*)((char*)blocks + blockSize * (i + 1));
+        block->next = next;
+    }
+    Block* last = (Block*)((char*)blocks + blockSize * (capacity - 1));
+    last->next = tail;
+
+    return blocks;
+#endif
+}
+
+void BlockAllocator::RecycleChunks()
+{
+    // Budget memory is never given back, so every block goes back on the free lists instead
+    memset(freeList, 0, sizeof(freeList));
+    memset(lineFreeList, 0, sizeof(lineFreeList));
+    for (size_t i = 0; i < block_size_count; ++i)
+    {
+        freeCounts[i].store(0, std::memory_order_relaxed);
+    }
+
+#if defined(SALLOC_HARDENED)
+    guard.Clear();
+#endif
+
+    for (Chunk* chunk = chunks; chunk; chunk = chunk->next)
+    {
+        size_t index = GetBlockSizeIndex(chunk->blockSize);
+        size_t chunkSize = chunk->capacity * chunk->blockSize;
+
+        sallocUnpoison(chunk->blocks, chunkSize);
+        freeList[index] = LinkBlocks(chunk->blocks, chunk->blockSize, chunk->capacity, freeList[index]);
+        sallocPoison(chunk->blocks, chunkSize);
+
+        freeCounts[index].store(freeCounts[index].load(std::memory_order_relaxed) + chunk->capacity, std::memory_order_relaxed);
+    }
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        for (Chunk* chunk = lineChunks[i]; chunk; chunk = chunk->next)
+        {
+            // Isolated strides carry one more cache line
+            size_t index = chunk->blockSize / cache_line_size - 1 - i;
+            size_t chunkSize = chunk->capacity * chunk->blockSize;
+
+            sallocUnpoison(chunk->blocks, chunkSize);
+            lineFreeList[i][index] = LinkBlocks(chunk->blocks, chunk->blockSize, chunk->capacity, lineFreeList[i][index]);
+            sallocPoison(chunk->blocks, chunkSize);
+        }
+    }
+
+    blockCount = 0;
+}
+
+void BlockAllocator::DiscardReadyChunks()
+{
+    // Refill passes run under the lock, so no chunk prepared for the state before the clear is stored after it
+    std::lock_guard<std::mutex> lock(refillMutex);
+
+    for (size_t i = 0; i < block_size_count; ++i)
+    {
+        Chunk* ready = readyChunks[i].exchange(nullptr, std::memory_order_acquire);
+        if (ready)
+        {
+            sallocUnpoison(ready->blocks, ready->capacity * ready->blockSize);
+            salloc::Free(ready->blocks);
+            salloc::Free(ready);
+        }
+
+        freeCounts[i].store(0, std::memory_order_relaxed);
+        lastChunkSizes[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void BlockAllocator::SpliceChunk(size_t index, Chunk* chunk)
+{
+    assert(freeList[index] == nullptr);
+
+    size_t blockSize = chunk->blockSize;
+
+#if defined(SALLOC_HARDENED)
+    // The free list guard isn't shared with the refill thread, so the blocks are shuffled and linked here
+    Block* head = guard.AddChunk(chunk->blocks, blockSize, chunk->capacity);
+    sallocPoison(chunk->blocks, chunk->capacity * blockSize);
+#else
+    Block* head = chunk->blocks;
+#endif
+
+    chunk->next = chunks;
+    chunks = chunk;
+    ++chunkCount;
+
+    chunkSizes[index] = chunk->capacity * blockSize;
+    lastChunkSizes[index].store(chunkSizes[index], std::memory_order_relaxed);
+
+    freeList[index] = head;
+    freeCounts[index].store(freeCounts[index].load(std::memory_order_relaxed) + chunk->capacity, std::memory_order_relaxed);
+}
+
+void BlockAllocator::StartBackgroundRefill(std::chrono::microseconds interval)
+{
+    // Realtime mode never grows past its budget
+    assert(budget == nullptr);
+
+    if (refillThread.joinable() || budget)
+    {
+        return;
     }
 
-    return chunkSizes[index];
+    refillRunning = true;
+    refillThread = std::thread(&BlockAllocator::RefillLoop, this, interval);
+}
+
+void BlockAllocator::StopBackgroundRefill()
+{
+    if (!refillThread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(refillMutex);
+        refillRunning = false;
+    }
+    refillSignal.notify_one();
+    chunkSignal.notify_all();
+    refillThread.join();
+}
+
+bool BlockAllocator::IsChunkReady(size_t size) const
+{
+    return readyChunks[GetBlockSizeIndex(size)].load(std::memory_order_acquire) != nullptr;
+}
+
+void BlockAllocator::WaitForChunk(size_t size)
+{
+    size_t index = GetBlockSizeIndex(size);
+
+    std::unique_lock<std::mutex> lock(refillMutex);
+    chunkSignal.wait(lock, [&]() { return !refillRunning || readyChunks[index].load(std::memory_order_acquire) != nullptr; });
+}
+
+void BlockAllocator::RefillLoop(std::chrono::microseconds interval)
+{
+    // Each pass holds the lock, which fences it against Clear
+    std::unique_lock<std::mutex> lock(refillMutex);
+    while (refillRunning)
+    {
+        bool prepared = false;
+
+        for (size_t i = 0; i < block_size_count; ++i)
+        {
+            size_t lastChunkSize = lastChunkSizes[i].load(std::memory_order_relaxed);
+            if (lastChunkSize == 0 || readyChunks[i].load(std::memory_order_relaxed) != nullptr)
+            {
+                continue;
+            }
+
+            // Grow chunk size by half, as the allocating thread does
+            size_t blockSize = (i + 1) * block_unit;
+            size_t chunkSize = lastChunkSize + lastChunkSize / 2;
+
+            // Prepare the next chunk once the free list is down to half of it, or below the watermark
+            size_t depth = std::max(chunkSize / blockSize / 2, watermarks[i].load(std::memory_order_relaxed));
+            if (freeCounts[i].load(std::memory_order_relaxed) >= depth)
+            {
+                continue;
+            }
+
+            readyChunks[i].store(PrepareChunk(i, chunkSize), std::memory_order_release);
+            prepared = true;
+        }
+
+        if (prepared)
+        {
+            chunkSignal.notify_all();
+        }
+
+        refillSignal.wait_for(lock, interval, [this]() { return !refillRunning; });
+    }
+}
+
+Chunk* BlockAllocator::PrepareChunk(size_t index, size_t chunkSize)
+{
+    size_t blockSize = (index + 1) * block_unit;
+    size_t blockCapacity = chunkSize / blockSize;
+
+    Block* blocks = (Block*)salloc::Alloc(chunkSize);
+
+#if defined(SALLOC_HARDENED)
+    // Only fault in the pages, the allocating thread links the blocks
+    memset(blocks, 0, blockCapacity * blockSize);
+#else
+    LinkBlocks(blocks, blockSize, blockCapacity, nullptr);
+    sallocPoison(blocks, blockCapacity * blockSize);
+#endif
+
+    Chunk* chunk = (Chunk*)salloc::Alloc(sizeof(Chunk));
+    chunk->capacity = blockCapacity;
+    chunk->blockSize = blockSize;
+    chunk->blocks = blocks;
+    chunk->next = nullptr;
+
+    return chunk;
 }
 
 } // namespace salloc
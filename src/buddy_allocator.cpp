@@ -0,0 +1,243 @@
+#include "salloc/buddy_allocator.h"
+
+#include <bit>
+
+namespace salloc
+{
+
+BuddyAllocator::BuddyAllocator(size_t regionSize, size_t minBlockSize)
+    : owned{ true }
+    , regionSize{ std::bit_ceil(regionSize < minBlockSize ? minBlockSize : regionSize) }
+{
+    memory = (char*)salloc::AlignedAlloc(this->regionSize, minBlockSize);
+    Init(minBlockSize);
+}
+
+BuddyAllocator::BuddyAllocator(void* memory, size_t size, size_t minBlockSize)
+    : owned{ false }
+    , memory{ (char*)memory }
+    , regionSize{ size }
+{
+    assert(size % minBlockSize == 0 && std::has_single_bit(size / minBlockSize));
+    Init(minBlockSize);
+}
+
+BuddyAllocator::~BuddyAllocator()
+{
+    salloc::Free(links);
+
+    sallocUnpoison(memory, regionSize);
+    if (owned)
+    {
+        salloc::AlignedFree(memory);
+    }
+}
+
+void BuddyAllocator::Init(size_t minBlockSize)
+{
+    assert(memory != nullptr);
+    assert(std::has_single_bit(minBlockSize));
+
+    this->minBlockSize = minBlockSize;
+    orderCount = std::bit_width(regionSize / minBlockSize);
+    assert(orderCount <= max_order_count);
+
+    // Links and both bitmaps in one allocation
+    size_t nodeCount = size_t(1) << orderCount;
+    size_t wordCount = (nodeCount + 63) / 64;
+    links = (Link*)salloc::Alloc(nodeCount * sizeof(Link) + 2 * wordCount * sizeof(uint64_t));
+    freeBits = (uint64_t*)(links + nodeCount);
+    splitBits = freeBits + wordCount;
+
+    Clear();
+}
+
+void* BuddyAllocator::Allocate(size_t size)
+{
+    if (size == 0 || size > regionSize)
+    {
+        return nullptr;
+    }
+
+    size_t order = GetOrder(size);
+
+    // Smallest free block that fits
+    size_t current = order;
+    while (current < orderCount && freeLists[current] == 0)
+    {
+        ++current;
+    }
+    if (current == orderCount)
+    {
+        return nullptr;
+    }
+
+    size_t node = freeLists[current];
+    Remove(current, node);
+
+    // Split down to the order, keeping the first half and freeing the second
+    while (current > order)
+    {
+        SetBit(splitBits, node, true);
+        --current;
+        node *= 2;
+        Push(current, node + 1);
+    }
+
+    ++usedCounts[order];
+    freeSize -= minBlockSize << order;
+
+    char* p = GetBlock(node, order);
+    sallocUnpoison(p, size);
+
+    return p;
+}
+
+void BuddyAllocator::Free(void* p, size_t size)
+{
+    if (p == nullptr)
+    {
+        return;
+    }
+
+    size_t order = GetOrder(size);
+    size_t node = GetNode(p, order);
+    size_t blockSize = minBlockSize << order;
+    assert(((char*)p - memory) % blockSize == 0);
+    assert(!GetBit(freeBits, node) && !GetBit(splitBits, node));
+
+    --usedCounts[order];
+    freeSize += blockSize;
+
+    sallocPoison(p, blockSize);
+
+    // Merge upwards while the buddy is free
+    while (node > 1)
+    {
+        size_t buddy = node ^ 1;
+        if (!GetBit(freeBits, buddy))
+        {
+            break;
+        }
+
+        Remove(order, buddy);
+        node /= 2;
+        ++order;
+        SetBit(splitBits, node, false);
+    }
+
+    Push(order, node);
+}
+
+void BuddyAllocator::Clear()
+{
+    size_t wordCount = ((size_t(1) << orderCount) + 63) / 64;
+    memset(freeBits, 0, 2 * wordCount * sizeof(uint64_t));
+
+    memset(freeLists, 0, sizeof(freeLists));
+    memset(freeCounts, 0, sizeof(freeCounts));
+    memset(usedCounts, 0, sizeof(usedCounts));
+
+    freeSize = regionSize;
+    Push(orderCount - 1, 1);
+
+    sallocPoison(memory, regionSize);
+}
+
+void* BuddyAllocator::Reallocate(void* p, size_t oldSize, size_t newSize)
+{
+    if (p == nullptr || newSize == 0 || newSize > regionSize || GetOrder(oldSize) != GetOrder(newSize))
+    {
+        return Allocator::Reallocate(p, oldSize, newSize);
+    }
+
+    size_t blockSize = minBlockSize << GetOrder(newSize);
+    sallocUnpoison(p, newSize);
+    sallocPoison((char*)p + newSize, blockSize - newSize);
+
+    return p;
+}
+
+size_t BuddyAllocator::GetOrder(size_t size) const
+{
+    size_t blockCount = (size + minBlockSize - 1) / minBlockSize;
+    return blockCount <= 1 ? 0 : std::bit_width(blockCount - 1);
+}
+
+BuddyStats BuddyAllocator::GetStats(size_t order) const
+{
+    assert(order < orderCount);
+    return BuddyStats{ minBlockSize << order, freeCounts[order], usedCounts[order] };
+}
+
+size_t BuddyAllocator::GetLargestFreeBlock() const
+{
+    for (size_t order = orderCount; order > 0; --order)
+    {
+        if (freeCounts[order - 1] > 0)
+        {
+            return minBlockSize << (order - 1);
+        }
+    }
+
+    return 0;
+}
+
+double BuddyAllocator::GetFragmentation() const
+{
+    if (freeSize == 0)
+    {
+        return 0.0;
+    }
+
+    return 1.0 - double(GetLargestFreeBlock()) / double(freeSize);
+}
+
+size_t BuddyAllocator::GetNode(const void* p, size_t order) const
+{
+    assert(memory <= (char*)p && (char*)p < memory + regionSize);
+    return (size_t(1) << GetLevel(order)) + ((char*)p - memory) / (minBlockSize << order);
+}
+
+char* BuddyAllocator::GetBlock(size_t node, size_t order) const
+{
+    return memory + (node - (size_t(1) << GetLevel(order))) * (minBlockSize << order);
+}
+
+void BuddyAllocator::Push(size_t order, size_t node)
+{
+    uint32_t head = freeLists[order];
+    links[node].next = head;
+    links[node].prev = 0;
+    if (head)
+    {
+        links[head].prev = (uint32_t)node;
+    }
+
+    freeLists[order] = (uint32_t)node;
+    SetBit(freeBits, node, true);
+    ++freeCounts[order];
+}
+
+void BuddyAllocator::Remove(size_t order, size_t node)
+{
+    Link link = links[node];
+    if (link.prev)
+    {
+        links[link.prev].next = link.next;
+    }
+    else
+    {
+        freeLists[order] = link.next;
+    }
+
+    if (link.next)
+    {
+        links[link.next].prev = link.prev;
+    }
+
+    SetBit(freeBits, node, false);
+    --freeCounts[order];
+}
+
+} // namespace salloc
@@ -0,0 +1,184 @@
+#include "salloc/hardening.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace salloc
+{
+
+[[noreturn]] static void ReportCorruption(const char* message, const void* p)
+{
+    std::fprintf(stderr, "salloc: %s (%p)\n", message, p);
+    std::abort();
+}
+
+FreeListGuard::FreeListGuard()
+    : ranges{ nullptr }
+    , rangeCount{ 0 }
+    , rangeCapacity{ 0 }
+{
+    std::random_device device;
+    uint64_t seed = ((uint64_t)device() << 32) | device();
+    seed ^= (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    seed ^= (uintptr_t)this;
+
+    secret = (uintptr_t)(seed | 1);
+    random = seed ^ 0x9E3779B97F4A7C15ull;
+}
+
+FreeListGuard::~FreeListGuard()
+{
+    Clear();
+    salloc::Free(ranges);
+}
+
+Block* FreeListGuard::AddChunk(Block* blocks, size_t blockSize, size_t capacity, Block* tail)
+{
+    if (rangeCount == rangeCapacity)
+    {
+        // Grow range array by half
+        ChunkRange* old = ranges;
+        rangeCapacity = rangeCapacity == 0 ? 16 : rangeCapacity + rangeCapacity / 2;
+        ranges = (ChunkRange*)salloc::Alloc(rangeCapacity * sizeof(ChunkRange));
+        if (old)
+        {
+            memcpy(ranges, old, rangeCount * sizeof(ChunkRange));
+            salloc::Free(old);
+        }
+    }
+
+    size_t wordCount = (capacity + 63) / 64;
+    uint64_t* allocated = (uint64_t*)salloc::Alloc(wordCount * sizeof(uint64_t));
+    memset(allocated, 0, wordCount * sizeof(uint64_t));
+
+    // Keep the ranges sorted for binary search
+    size_t i = rangeCount;
+    while (i > 0 && ranges[i - 1].begin > (char*)blocks)
+    {
+        ranges[i] = ranges[i - 1];
+        --i;
+    }
+    ranges[i] = ChunkRange{ (char*)blocks, (char*)blocks + blockSize * capacity, blockSize, allocated };
+    ++rangeCount;
+
+    // Shuffle the block order with Fisher-Yates
+    size_t* order = (size_t*)salloc::Alloc(capacity * sizeof(size_t));
+    for (size_t j = 0; j < capacity; ++j)
+    {
+        order[j] = j;
+    }
+    for (size_t j = capacity - 1; j > 0; --j)
+    {
+        size_t k = NextRandom() % (j + 1);
+        size_t t = order[j];
+        order[j] = order[k];
+        order[k] = t;
+    }
+
+    Block* head = tail;
+    for (size_t j = 0; j < capacity; ++j)
+    {
+        Block* block = (Block*)((char*)blocks + blockSize * order[j]);
+        block->next = Encode(block, head);
+        head = block;
+    }
+
+    salloc::Free(order);
+
+    return head;
+}
+
+Block* FreeListGuard::Pop(Block* head, size_t blockSize)
+{
+    ChunkRange* range = Find(head);
+    if (range == nullptr)
+    {
+        ReportCorruption("free list points outside of the chunks", head);
+    }
+
+    size_t index = GetBlockIndex(range, head, blockSize);
+    uint64_t bit = 1ull << (index % 64);
+    if (range->allocated[index / 64] & bit)
+    {
+        ReportCorruption("free list points to an allocated block", head);
+    }
+    range->allocated[index / 64] |= bit;
+
+    return Decode(head);
+}
+
+void FreeListGuard::Push(Block* block, Block* head, size_t blockSize)
+{
+    ChunkRange* range = Find(block);
+    if (range == nullptr)
+    {
+        ReportCorruption("freeing a pointer not owned by the allocator", block);
+    }
+
+    size_t index = GetBlockIndex(range, block, blockSize);
+    uint64_t bit = 1ull << (index % 64);
+    if ((range->allocated[index / 64] & bit) == 0)
+    {
+        ReportCorruption("double free", block);
+    }
+    range->allocated[index / 64] &= ~bit;
+
+    block->next = Encode(block, head);
+}
+
+void FreeListGuard::Clear()
+{
+    for (size_t i = 0; i < rangeCount; ++i)
+    {
+        salloc::Free(ranges[i].allocated);
+    }
+
+    rangeCount = 0;
+}
+
+FreeListGuard::ChunkRange* FreeListGuard::Find(const void* p) const
+{
+    size_t lo = 0;
+    size_t hi = rangeCount;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if ((const char*)p < ranges[mid].begin)
+        {
+            hi = mid;
+        }
+        else if ((const char*)p >= ranges[mid].end)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            return ranges + mid;
+        }
+    }
+
+    return nullptr;
+}
+
+size_t FreeListGuard::GetBlockIndex(const ChunkRange* range, const void* p, size_t blockSize) const
+{
+    size_t offset = (const char*)p - range->begin;
+    if (range->blockSize != blockSize || offset % blockSize != 0)
+    {
+        ReportCorruption("pointer is not the start of a block of this size", p);
+    }
+
+    return offset / blockSize;
+}
+
+uint64_t FreeListGuard::NextRandom()
+{
+    // xorshift64
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    return random;
+}
+
+} // namespace salloc
@@ -0,0 +1,142 @@
+#include "salloc/instrumentation.h"
+
+#include <bit>
+#include <chrono>
+#include <thread>
+
+namespace salloc
+{
+
+#if defined(SALLOC_INSTRUMENT)
+Histogram instrumentHistograms[instrument_event_count][instrument_class_count];
+#endif
+
+size_t Histogram::GetBucket(uint64_t value)
+{
+    // Values below sub_bucket_count get a bucket each
+    if (value < sub_bucket_count)
+    {
+        return (size_t)value;
+    }
+
+    size_t exponent = std::bit_width(value) - 1;
+    size_t mantissa = (size_t)(value >> (exponent - sub_bucket_bits)) & (sub_bucket_count - 1);
+
+    return (exponent - sub_bucket_bits + 1) * sub_bucket_count + mantissa;
+}
+
+uint64_t Histogram::GetBucketBound(size_t bucket)
+{
+    if (bucket < sub_bucket_count)
+    {
+        return bucket;
+    }
+
+    size_t exponent = bucket / sub_bucket_count + sub_bucket_bits - 1;
+    uint64_t mantissa = bucket % sub_bucket_count;
+    uint64_t next = sub_bucket_count + mantissa + 1;
+
+    // Wraps to the largest value for the last bucket
+    return (next << (exponent - sub_bucket_bits)) - 1;
+}
+
+void Histogram::Record(uint64_t value)
+{
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    buckets[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::GetPercentile(double percentile) const
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < bucket_count; ++i)
+    {
+        total += buckets[i].load(std::memory_order_relaxed);
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * double(total) + 0.5);
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucket_count; ++i)
+    {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            return GetBucketBound(i);
+        }
+    }
+
+    return GetBucketBound(bucket_count - 1);
+}
+
+void ExportInstrumentation(InstrumentExporter exporter, void* userData)
+{
+#if defined(SALLOC_INSTRUMENT)
+    for (size_t event = 0; event < instrument_event_count; ++event)
+    {
+        for (size_t sizeClass = 0; sizeClass < instrument_class_count; ++sizeClass)
+        {
+            const Histogram& histogram = instrumentHistograms[event][sizeClass];
+            if (histogram.count.load(std::memory_order_relaxed) == 0)
+            {
+                continue;
+            }
+
+            InstrumentRecord record{ (InstrumentEvent)event, sizeClass * instrument_class_unit, histogram };
+            exporter(record, userData);
+        }
+    }
+#else
+    (void)exporter;
+    (void)userData;
+#endif
+}
+
+void ResetInstrumentation()
+{
+#if defined(SALLOC_INSTRUMENT)
+    for (auto& histograms : instrumentHistograms)
+    {
+        for (Histogram& histogram : histograms)
+        {
+            histogram.count.store(0, std::memory_order_relaxed);
+            histogram.sum.store(0, std::memory_order_relaxed);
+            for (std::atomic<uint64_t>& bucket : histogram.buckets)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+#endif
+}
+
+double GetTickFrequency()
+{
+#if defined(SALLOC_RDTSC)
+    static double frequency = []() {
+        auto begin = std::chrono::steady_clock::now();
+        uint64_t beginTicks = ReadTicks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        uint64_t endTicks = ReadTicks();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+        return double(endTicks - beginTicks) / elapsed.count();
+    }();
+
+    return frequency;
+#else
+    // Nanoseconds of the steady clock
+    return 1e9;
+#endif
+}
+
+} // namespace salloc
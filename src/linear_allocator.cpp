@@ -1,4 +1,5 @@
 #include "salloc/linear_allocator.h"
+#include "salloc/virtual_memory.h"
 
 namespace salloc
 {
@@ -10,9 +11,59 @@ LinearAllocator::LinearAllocator(size_t initialCapacity)
     , index{ 0 }
     , allocation{ 0 }
     , maxAllocation{ 0 }
+    , reserved{ false }
+    , guard{ GuardMode::none }
+    , commitSize{ 0 }
+    , committed{ 0 }
+    , peakIndex{ 0 }
+    , budget{ nullptr }
+    , onExhausted{ nullptr }
 {
     mem = (char*)salloc::Alloc(capacity);
     memset(mem, 0, capacity);
+    sallocPoison(mem, capacity);
+    entries = (MemoryEntry*)salloc::Alloc(entryCapacity * sizeof(MemoryEntry));
+}
+
+LinearAllocator::LinearAllocator(RealtimeBudget& budget, size_t capacity, size_t entryCapacity, ExhaustionHandler onExhausted)
+    : entryCount{ 0 }
+    , entryCapacity{ entryCapacity }
+    , capacity{ capacity }
+    , index{ 0 }
+    , allocation{ 0 }
+    , maxAllocation{ 0 }
+    , reserved{ false }
+    , guard{ GuardMode::none }
+    , commitSize{ 0 }
+    , committed{ 0 }
+    , peakIndex{ 0 }
+    , budget{ &budget }
+    , onExhausted{ onExhausted }
+{
+    mem = (char*)budget.Allocate(capacity);
+    entries = (MemoryEntry*)budget.Allocate(entryCapacity * sizeof(MemoryEntry));
+    assert(mem != nullptr && entries != nullptr);
+
+    sallocPoison(mem, capacity);
+}
+
+LinearAllocator::LinearAllocator(const LinearReservation& reservation)
+    : entryCount{ 0 }
+    , entryCapacity{ 32 }
+    , capacity{ RoundUpToPage(reservation.reservedSize) }
+    , index{ 0 }
+    , allocation{ 0 }
+    , maxAllocation{ 0 }
+    , reserved{ true }
+    , guard{ reservation.guard }
+    , commitSize{ reservation.guard == GuardMode::none ? RoundUpToPage(reservation.commitSize) : GetPageSize() }
+    , committed{ 0 }
+    , peakIndex{ 0 }
+    , budget{ nullptr }
+    , onExhausted{ nullptr }
+{
+    mem = (char*)ReserveMemory(capacity + GetPageSize());
+    assert(mem != nullptr);
     entries = (MemoryEntry*)salloc::Alloc(entryCapacity * sizeof(MemoryEntry));
 }
 
@@ -20,12 +71,32 @@ LinearAllocator::~LinearAllocator()
 {
     assert(index == 0 && entryCount == 0);
 
+    // Budget memory goes back with the budget
+    if (budget)
+    {
+        return;
+    }
+
+    if (reserved)
+    {
+        salloc::Free(entries);
+        sallocUnpoison(mem, committed);
+        ReleaseMemory(mem, capacity + GetPageSize());
+        return;
+    }
+
     salloc::Free(entries);
+    sallocUnpoison(mem, capacity);
     salloc::Free(mem);
 }
 
 void* LinearAllocator::Allocate(size_t size)
 {
+    if (budget && (entryCount == entryCapacity || index + size + redzone_size > capacity))
+    {
+        return ReportExhaustion(onExhausted, size);
+    }
+
     if (entryCount == entryCapacity)
     {
         // Grow entry array by half
@@ -37,19 +108,42 @@ void* LinearAllocator::Allocate(size_t size)
         salloc::Free(old);
     }
 
+    // Pages past the committed part are committed in place, the reservation never spills to malloc
+    if (reserved && guard != GuardMode::electric_fence && index + size + redzone_size > committed &&
+        !Commit(index + size + redzone_size))
+    {
+        return nullptr;
+    }
+
     MemoryEntry* entry = entries + entryCount;
     entry->size = size;
 
-    if (index + size > capacity)
+    if (guard == GuardMode::electric_fence)
+    {
+        entry->data = AllocateFenced(size);
+        entry->mallocUsed = false;
+        if (entry->data == nullptr)
+        {
+            return nullptr;
+        }
+    }
+    else if (index + size + redzone_size > capacity)
     {
         entry->data = (char*)salloc::Alloc(size);
         entry->mallocUsed = true;
     }
     else
     {
+        // The redzone after the allocation stays poisoned
         entry->data = mem + index;
         entry->mallocUsed = false;
-        index += size;
+        index += size + redzone_size;
+        sallocUnpoison(entry->data, size);
+
+        if (index > peakIndex)
+        {
+            peakIndex = index;
+        }
     }
 
     allocation += size;
@@ -76,9 +170,17 @@ void LinearAllocator::Free(void* p, size_t size)
     {
         salloc::Free(p);
     }
+    else if (guard == GuardMode::electric_fence)
+    {
+        // Later accesses fault
+        char* begin = mem + ((char*)p - mem) / GetPageSize() * GetPageSize();
+        DecommitMemory(begin, index - GetPageSize() - (begin - mem));
+        index = begin - mem;
+    }
     else
     {
-        index -= entry->size;
+        index -= entry->size + redzone_size;
+        sallocPoison(p, entry->size);
     }
 
     allocation -= entry->size;
@@ -87,30 +189,196 @@ void LinearAllocator::Free(void* p, size_t size)
     p = nullptr;
 }
 
+void* LinearAllocator::Reallocate(void* p, size_t oldSize, size_t newSize)
+{
+    if (p == nullptr || newSize == 0)
+    {
+        return Allocator::Reallocate(p, oldSize, newSize);
+    }
+
+    assert(entryCount > 0);
+
+    // Only the top allocation can be resized
+    MemoryEntry* entry = entries + (entryCount - 1);
+    assert(entry->data == p);
+    assert(entry->size == oldSize);
+
+    if (entry->mallocUsed)
+    {
+        // Leaves the allocation as it is on failure
+        char* data = (char*)salloc::Realloc(p, newSize);
+        if (data == nullptr)
+        {
+            return nullptr;
+        }
+
+        entry->data = data;
+    }
+    else if (guard == GuardMode::electric_fence)
+    {
+        // Moves to stay flush against the next page
+        size_t pageSize = GetPageSize();
+        char* begin = mem + ((char*)p - mem) / pageSize * pageSize;
+        size_t oldSpan = index - pageSize - (begin - mem);
+        size_t span = RoundUpToPage(newSize);
+        if ((begin - mem) + span + pageSize > capacity || !CommitMemory(begin, span))
+        {
+            // Leaves the allocation as it is
+            return nullptr;
+        }
+
+        char* data = begin + span - newSize;
+        memmove(data, p, oldSize < newSize ? oldSize : newSize);
+        if (oldSpan > span)
+        {
+            DecommitMemory(begin + span, oldSpan - span);
+        }
+
+        entry->data = data;
+        index = (begin - mem) + span + pageSize;
+    }
+    else if (index - oldSize + newSize <= (reserved ? committed : capacity) ||
+             (reserved && Commit(index - oldSize + newSize)))
+    {
+        index = index - oldSize + newSize;
+        sallocPoison(p, oldSize + redzone_size);
+        sallocUnpoison(p, newSize);
+
+        if (index > peakIndex)
+        {
+            peakIndex = index;
+        }
+    }
+    else if (reserved)
+    {
+        // Leaves the allocation as it is
+        return nullptr;
+    }
+    else if (budget)
+    {
+        // Leaves the allocation as it is
+        return ReportExhaustion(onExhausted, newSize);
+    }
+    else
+    {
+        // Move out to the upstream allocator
+        char* data = (char*)salloc::Alloc(newSize);
+        if (data == nullptr)
+        {
+            return nullptr;
+        }
+
+        entry->data = data;
+        entry->mallocUsed = true;
+        memcpy(entry->data, p, oldSize);
+        index -= oldSize + redzone_size;
+        sallocPoison(p, oldSize);
+    }
+
+    entry->size = newSize;
+
+    allocation = allocation - oldSize + newSize;
+    if (allocation > maxAllocation)
+    {
+        maxAllocation = allocation;
+    }
+
+    return entry->data;
+}
+
 bool LinearAllocator::GrowMemory()
 {
     assert(index == 0);
 
-    if (maxAllocation < capacity)
+    if (maxAllocation < capacity || budget || reserved)
     {
         return false;
     }
 
     // Grow memory by half
+    sallocUnpoison(mem, capacity);
     salloc::Free(mem);
     capacity += capacity / 2;
     mem = (char*)salloc::Alloc(capacity);
     memset(mem, 0, capacity);
+    sallocPoison(mem, capacity);
 
     return true;
 }
 
 void LinearAllocator::Clear()
 {
+    if (guard == GuardMode::electric_fence)
+    {
+        if (index > 0)
+        {
+            DecommitMemory(mem, index);
+        }
+
+        peakIndex = 0;
+    }
+    else if (reserved)
+    {
+        // Keep what the last round used, give back the rest
+        size_t keep = (peakIndex + commitSize - 1) / commitSize * commitSize;
+        if (keep < committed)
+        {
+            sallocUnpoison(mem + keep, committed - keep);
+            DecommitMemory(mem + keep, committed - keep);
+            committed = keep;
+        }
+
+        sallocPoison(mem, committed);
+        peakIndex = 0;
+    }
+    else
+    {
+        sallocPoison(mem, capacity);
+    }
+
     entryCount = 0;
     index = 0;
     allocation = 0;
     maxAllocation = 0;
 }
 
+char* LinearAllocator::AllocateFenced(size_t size)
+{
+    // Pages of its own, followed by one left uncommitted
+    size_t pageSize = GetPageSize();
+    size_t span = size == 0 ? pageSize : RoundUpToPage(size);
+    if (index + span + pageSize > capacity || !CommitMemory(mem + index, span))
+    {
+        return nullptr;
+    }
+
+    char* data = mem + index + span - size;
+    index += span + pageSize;
+
+    if (index > peakIndex)
+    {
+        peakIndex = index;
+    }
+
+    return data;
+}
+
+bool LinearAllocator::Commit(size_t size)
+{
+    size_t newCommitted = (size + commitSize - 1) / commitSize * commitSize;
+    if (newCommitted > capacity)
+    {
+        newCommitted = capacity;
+    }
+    if (size > newCommitted || !CommitMemory(mem + committed, newCommitted - committed))
+    {
+        return false;
+    }
+
+    sallocPoison(mem + committed, newCommitted - committed);
+    committed = newCommitted;
+
+    return true;
+}
+
 } // namespace salloc
@@ -0,0 +1,144 @@
+#include "salloc/node_pool_resource.h"
+
+namespace salloc
+{
+
+NodePoolResource::NodePoolResource(size_t initialChunkSize)
+    : initialChunkSize{ initialChunkSize }
+    , poolCount{ 0 }
+    , nodeCount{ 0 }
+    , upstream{ initialChunkSize }
+{
+    for (Pool& pool : pools)
+    {
+        pool = Pool{ nullptr, nullptr, nullptr, nullptr, initialChunkSize };
+    }
+}
+
+NodePoolResource::~NodePoolResource()
+{
+    Clear();
+}
+
+void* NodePoolResource::AllocateNode(size_t size)
+{
+    if (size == 0 || size > max_node_size)
+    {
+        return upstream.Allocate(size);
+    }
+
+    size_t index = (size - 1) / node_unit;
+    size_t nodeSize = (index + 1) * node_unit;
+    Pool& pool = pools[index];
+
+    void* node;
+    if (pool.freeList)
+    {
+        // Reuse freed nodes first
+        Block* block = pool.freeList;
+        sallocUnpoison(block, sizeof(Block));
+        pool.freeList = block->next;
+        node = block;
+    }
+    else
+    {
+        if (pool.cursor + nodeSize > pool.end)
+        {
+            if (pool.chunks == nullptr)
+            {
+                ++poolCount;
+            }
+
+            // Increase chunk size by half
+            pool.chunkSize += pool.chunkSize / 2;
+
+            size_t blockCapacity = pool.chunkSize / nodeSize;
+            char* blocks = (char*)salloc::Alloc(blockCapacity * nodeSize);
+
+            // Nodes are carved in order, so no free list is built up front
+            sallocPoison(blocks, blockCapacity * nodeSize);
+
+            Chunk* newChunk = (Chunk*)salloc::Alloc(sizeof(Chunk));
+            newChunk->capacity = blockCapacity;
+            newChunk->blockSize = nodeSize;
+            newChunk->blocks = (Block*)blocks;
+            newChunk->next = pool.chunks;
+            pool.chunks = newChunk;
+
+            pool.cursor = blocks;
+            pool.end = blocks + blockCapacity * nodeSize;
+        }
+
+        node = pool.cursor;
+        pool.cursor += nodeSize;
+    }
+
+    sallocPoison(node, nodeSize);
+    sallocUnpoison(node, size);
+    ++nodeCount;
+
+    return node;
+}
+
+void NodePoolResource::FreeNode(void* p, size_t size)
+{
+    if (size == 0 || size > max_node_size)
+    {
+        upstream.Free(p, size);
+        return;
+    }
+
+    size_t index = (size - 1) / node_unit;
+    size_t nodeSize = (index + 1) * node_unit;
+    Pool& pool = pools[index];
+
+#if defined(_DEBUG)
+    // Verify the memory address and size is valid.
+    bool found = false;
+
+    Chunk* chunk = pool.chunks;
+    while (chunk)
+    {
+        if ((char*)chunk->blocks <= (char*)p && (char*)p + nodeSize <= (char*)chunk->blocks + chunk->capacity * nodeSize)
+        {
+            found = true;
+            break;
+        }
+        chunk = chunk->next;
+    }
+
+    assert(found);
+#endif
+
+    Block* block = (Block*)p;
+    sallocUnpoison(block, sizeof(Block));
+    block->next = pool.freeList;
+    sallocPoison(block, nodeSize);
+    pool.freeList = block;
+    --nodeCount;
+}
+
+void NodePoolResource::Clear()
+{
+    for (Pool& pool : pools)
+    {
+        Chunk* chunk = pool.chunks;
+        while (chunk)
+        {
+            Chunk* c0 = chunk;
+            chunk = c0->next;
+            sallocUnpoison(c0->blocks, c0->capacity * c0->blockSize);
+            salloc::Free(c0->blocks);
+            salloc::Free(c0);
+        }
+
+        pool = Pool{ nullptr, nullptr, nullptr, nullptr, initialChunkSize };
+    }
+
+    poolCount = 0;
+    nodeCount = 0;
+
+    upstream.Clear();
+}
+
+} // namespace salloc
@@ -0,0 +1,126 @@
+#include "salloc/numa.h"
+#include "salloc/virtual_memory.h"
+
+#include <cstddef>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace salloc
+{
+
+static size_t GetSystemCurrentNode()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+    unsigned int cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+    {
+        return node;
+    }
+#endif
+    return 0;
+}
+
+NumaTopology GetSystemNumaTopology()
+{
+    size_t nodeCount = 1;
+
+#if defined(__linux__)
+    // Online nodes are listed like "0-1"
+    if (FILE* file = std::fopen("/sys/devices/system/node/online", "r"))
+    {
+        unsigned int first, last;
+        int read = std::fscanf(file, "%u-%u", &first, &last);
+        if (read == 2)
+        {
+            nodeCount = last + 1;
+        }
+        std::fclose(file);
+    }
+#endif
+
+    if (nodeCount > NumaChunkPool::max_node_count)
+    {
+        nodeCount = NumaChunkPool::max_node_count;
+    }
+
+    return NumaTopology{ nodeCount, GetSystemCurrentNode, nodeCount > 1 };
+}
+
+NumaChunkPool::NumaChunkPool(const NumaTopology& topology, size_t nodeCapacity)
+    : topology{ topology }
+    , nodeCapacity{ RoundUpToPage(nodeCapacity) }
+{
+    assert(0 < topology.nodeCount && topology.nodeCount <= max_node_count);
+
+    for (size_t i = 0; i < topology.nodeCount; ++i)
+    {
+        Node& node = nodes[i];
+        node.mem = (char*)ReserveMemory(this->nodeCapacity);
+        node.committed = 0;
+        node.index = 0;
+        assert(node.mem != nullptr);
+
+        if (topology.bindMemory)
+        {
+            BindMemory(node.mem, this->nodeCapacity, i);
+        }
+    }
+}
+
+NumaChunkPool::~NumaChunkPool()
+{
+    for (size_t i = 0; i < topology.nodeCount; ++i)
+    {
+        ReleaseMemory(nodes[i].mem, nodeCapacity);
+    }
+}
+
+void* NumaChunkPool::AllocateChunk(size_t n, size_t size)
+{
+    assert(n < topology.nodeCount);
+    Node& node = nodes[n];
+
+    // Keep chunks pointer aligned
+    size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+    if (node.index + size > nodeCapacity)
+    {
+        return nullptr;
+    }
+
+    if (node.index + size > node.committed)
+    {
+        size_t end = RoundUpToPage(node.index + size);
+        if (CommitMemory(node.mem + node.committed, end - node.committed) == false)
+        {
+            return nullptr;
+        }
+        node.committed = end;
+    }
+
+    void* chunk = node.mem + node.index;
+    node.index += size;
+
+    return chunk;
+}
+
+void NumaChunkPool::Clear()
+{
+    for (size_t i = 0; i < topology.nodeCount; ++i)
+    {
+        Node& node = nodes[i];
+        if (node.committed > 0)
+        {
+            DecommitMemory(node.mem, node.committed);
+        }
+
+        node.committed = 0;
+        node.index = 0;
+    }
+}
+
+} // namespace salloc
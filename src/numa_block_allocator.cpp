@@ -0,0 +1,144 @@
+#include "salloc/numa_block_allocator.h"
+
+namespace salloc
+{
+
+NumaBlockAllocator::NumaBlockAllocator(const NumaTopology& topology, size_t initialChunkSize, size_t nodeCapacity)
+    : pool(topology, nodeCapacity)
+    , initialChunkSize{ initialChunkSize }
+{
+    ResetNodes();
+}
+
+NumaBlockAllocator::~NumaBlockAllocator()
+{
+    Clear();
+}
+
+void* NumaBlockAllocator::Allocate(size_t size)
+{
+    if (size == 0)
+    {
+        return nullptr;
+    }
+    if (size > max_block_size)
+    {
+        return salloc::Alloc(size);
+    }
+
+    size_t index = (size - 1) / block_unit;
+    size_t blockSize = (index + 1) * block_unit;
+
+    size_t n = pool.GetCurrentNode();
+    Node& node = nodes[n];
+
+    std::lock_guard<std::mutex> lock(pool.GetLock(n));
+
+    if (node.freeList[index] == nullptr)
+    {
+        // Increase chunk size by half
+        node.chunkSizes[index] += node.chunkSizes[index] / 2;
+
+        size_t chunkSize = node.chunkSizes[index];
+        size_t blockCapacity = chunkSize / blockSize;
+
+        Block* blocks = (Block*)pool.AllocateChunk(n, chunkSize);
+        if (blocks == nullptr)
+        {
+            return nullptr;
+        }
+
+        // Build a linked list for the free list.
+        for (size_t i = 0; i < blockCapacity - 1; ++i)
+        {
+            Block* block = (Block*)((char*)blocks + blockSize * i);
+            Block* next = (Block*)((char*)blocks + blockSize * (i + 1));
+            block->next = next;
+        }
+        Block* last = (Block*)((char*)blocks + blockSize * (blockCapacity - 1));
+        last->next = nullptr;
+
+        ++node.chunkCount;
+
+        node.freeList[index] = blocks;
+    }
+
+    Block* block = node.freeList[index];
+    node.freeList[index] = block->next;
+    ++node.blockCount;
+
+    return block;
+}
+
+void NumaBlockAllocator::Free(void* p, size_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    if (size > max_block_size)
+    {
+        salloc::Free(p);
+        return;
+    }
+
+    size_t index = (size - 1) / block_unit;
+
+    // Return the block to the node owning its chunk
+    size_t n = pool.GetNode(p);
+    Node& node = nodes[n];
+
+    std::lock_guard<std::mutex> lock(pool.GetLock(n));
+
+    Block* block = (Block*)p;
+    block->next = node.freeList[index];
+    node.freeList[index] = block;
+    --node.blockCount;
+}
+
+void NumaBlockAllocator::Clear()
+{
+    pool.Clear();
+    ResetNodes();
+}
+
+size_t NumaBlockAllocator::GetBlockCount() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < pool.GetNodeCount(); ++i)
+    {
+        count += nodes[i].blockCount;
+    }
+
+    return count;
+}
+
+size_t NumaBlockAllocator::GetChunkCount() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < pool.GetNodeCount(); ++i)
+    {
+        count += nodes[i].chunkCount;
+    }
+
+    return count;
+}
+
+void NumaBlockAllocator::ResetNodes()
+{
+    for (size_t i = 0; i < NumaChunkPool::max_node_count; ++i)
+    {
+        Node& node = nodes[i];
+        node.blockCount = 0;
+        node.chunkCount = 0;
+        memset(node.freeList, 0, sizeof(node.freeList));
+
+        for (size_t j = 0; j < block_size_count; ++j)
+        {
+            node.chunkSizes[j] = initialChunkSize;
+        }
+    }
+}
+
+} // namespace salloc
@@ -1,4 +1,5 @@
 #include "salloc/predefined_block_allocator.h"
+#include "salloc/virtual_memory.h"
 
 namespace salloc
 {
@@ -7,16 +8,34 @@ PredefinedBlockAllocator::PredefinedBlockAllocator(size_t initialChunkSize, std:
     : sizeMap(std::move(blockSizes))
     , blockCount{ 0 }
     , chunkCount{ 0 }
-    , chunkSize{ initialChunkSize }
     , chunks{ nullptr }
 {
     freeList = (Block**)salloc::Alloc(sizeMap.sizes.size() * sizeof(Block*));
     memset(freeList, 0, sizeMap.sizes.size() * sizeof(Block*));
+
+    freeCounts = (size_t*)salloc::Alloc(sizeMap.sizes.size() * sizeof(size_t));
+    memset(freeCounts, 0, sizeMap.sizes.size() * sizeof(size_t));
+    watermarks = (size_t*)salloc::Alloc(sizeMap.sizes.size() * sizeof(size_t));
+    memset(watermarks, 0, sizeMap.sizes.size() * sizeof(size_t));
+
+    // Every size class starts with the same chunk size
+    blockCapacities = (size_t*)salloc::Alloc(sizeMap.sizes.size() * sizeof(size_t));
+    for (size_t i = 0; i < sizeMap.sizes.size(); ++i)
+    {
+        blockCapacities[i] = initialChunkSize / sizeMap.sizes[i];
+        if (blockCapacities[i] == 0)
+        {
+            blockCapacities[i] = 1;
+        }
+    }
 }
 
 PredefinedBlockAllocator::~PredefinedBlockAllocator()
 {
     Clear();
+    salloc::Free(watermarks);
+    salloc::Free(freeCounts);
+    salloc::Free(blockCapacities);
     salloc::Free(freeList);
 }
 
@@ -32,40 +51,30 @@ void* PredefinedBlockAllocator::Allocate(size_t size)
     }
 
     size_t index = sizeMap.values[size];
-    assert(0 <= index && index <= sizeMap.sizes.size());
+    assert(index <= sizeMap.sizes.size());
 
     if (freeList[index] == nullptr)
     {
-        chunkSize += chunkSize / 2;
-
-        Block* blocks = (Block*)salloc::Alloc(chunkSize);
-        size_t blockSize = sizeMap.sizes[index];
-        size_t blockCapacity = chunkSize / blockSize;
-
-        // Build a linked list for the free list.
-        for (size_t i = 0; i < blockCapacity - 1; ++i)
-        {
-            Block* block = (Block*)((char*)blocks + blockSize * i);
-            Block* next = (Block*)((char*)blocks + blockSize * (i + 1));
-            block->next = next;
-        }
-        Block* last = (Block*)((char*)blocks + blockSize * (blockCapacity - 1));
-        last->next = nullptr;
-
-        Chunk* newChunk = (Chunk*)salloc::Alloc(sizeof(Chunk));
-        newChunk->capacity = blockCapacity;
-        newChunk->blockSize = blockSize;
-        newChunk->blocks = blocks;
-        newChunk->next = chunks;
-        chunks = newChunk;
-        ++chunkCount;
-
-        freeList[index] = newChunk->blocks;
+        sallocInstrumentScope(InstrumentEvent::refill, sizeMap.sizes[index]);
+        CreateChunk(index, 1);
+    }
+    else
+    {
+        sallocInstrumentCount(InstrumentEvent::free_list_pop, sizeMap.sizes[index]);
     }
 
     Block* block = freeList[index];
+    sallocUnpoison(block, sizeof(Block));
+#if defined(SALLOC_HARDENED)
+    freeList[index] = guard.Pop(block, sizeMap.sizes[index]);
+#else
     freeList[index] = block->next;
+#endif
+    // Slack after the requested size stays poisoned
+    sallocPoison(block, sizeMap.sizes[index]);
+    sallocUnpoison(block, size);
     ++blockCount;
+    --freeCounts[index];
 
     return block;
 }
@@ -86,7 +95,7 @@ void PredefinedBlockAllocator::Free(void* p, size_t size)
     assert(0 < size && size <= sizeMap.MaxBlockSize());
 
     size_t index = sizeMap.values[size];
-    assert(0 <= index && index <= sizeMap.sizes.size());
+    assert(index <= sizeMap.sizes.size());
 
 #if defined(_DEBUG)
     // Verify the memory address and size is valid.
@@ -117,18 +126,28 @@ void PredefinedBlockAllocator::Free(void* p, size_t size)
 #endif
 
     Block* block = (Block*)p;
+    sallocUnpoison(block, sizeof(Block));
+#if defined(SALLOC_HARDENED)
+    guard.Push(block, freeList[index], sizeMap.sizes[index]);
+#else
     block->next = freeList[index];
+#endif
+    sallocPoison(block, sizeMap.sizes[index]);
     freeList[index] = block;
     --blockCount;
+    ++freeCounts[index];
 }
 
 void PredefinedBlockAllocator::Clear()
 {
+    sallocInstrumentScope(InstrumentEvent::clear, 0);
+
     Chunk* chunk = chunks;
     while (chunk)
     {
         Chunk* c0 = chunk;
         chunk = c0->next;
+        sallocUnpoison(c0->blocks, c0->capacity * c0->blockSize);
         salloc::Free(c0->blocks);
         salloc::Free(c0);
     }
@@ -137,6 +156,138 @@ void PredefinedBlockAllocator::Clear()
     chunkCount = 0;
     chunks = nullptr;
     memset(freeList, 0, sizeMap.sizes.size() * sizeof(Block*));
+    memset(freeCounts, 0, sizeMap.sizes.size() * sizeof(size_t));
+
+#if defined(SALLOC_HARDENED)
+    guard.Clear();
+#endif
+}
+
+size_t PredefinedBlockAllocator::GetChunkSize(size_t size) const
+{
+    assert(0 < size && size <= sizeMap.MaxBlockSize());
+
+    size_t index = sizeMap.values[size];
+    return blockCapacities[index] * sizeMap.sizes[index];
+}
+
+size_t PredefinedBlockAllocator::GetFreeCount(size_t size) const
+{
+    assert(0 < size && size <= sizeMap.MaxBlockSize());
+
+    return freeCounts[sizeMap.values[size]];
+}
+
+void PredefinedBlockAllocator::Reserve(size_t size, size_t count)
+{
+    if (size == 0 || size > sizeMap.MaxBlockSize())
+    {
+        return;
+    }
+
+    size_t index = sizeMap.values[size];
+    if (freeCounts[index] < count)
+    {
+        CreateChunk(index, count - freeCounts[index]);
+    }
+}
+
+void PredefinedBlockAllocator::Prewarm(std::span<const Reservation> profile)
+{
+    for (const Reservation& reservation : profile)
+    {
+        Reserve(reservation.size, reservation.count);
+    }
+}
+
+void PredefinedBlockAllocator::SetWatermark(size_t size, size_t count)
+{
+    assert(0 < size && size <= sizeMap.MaxBlockSize());
+
+    watermarks[sizeMap.values[size]] = count;
+}
+
+void PredefinedBlockAllocator::Replenish()
+{
+    for (size_t i = 0; i < sizeMap.sizes.size(); ++i)
+    {
+        if (freeCounts[i] < watermarks[i])
+        {
+            CreateChunk(i, watermarks[i] - freeCounts[i]);
+        }
+    }
+}
+
+void PredefinedBlockAllocator::CreateChunk(size_t index, size_t minCapacity)
+{
+    size_t blockSize = sizeMap.sizes[index];
+
+    // Grow the chunk of this size class by half, rounded up to whole pages.
+    // Larger reservations get a chunk of their own and leave the growth as it is
+    size_t growth = blockCapacities[index] + blockCapacities[index] / 2;
+    size_t chunkSize = RoundUpToPage((growth < minCapacity ? minCapacity : growth) * blockSize);
+    size_t blockCapacity = chunkSize / blockSize;
+    if (growth >= minCapacity)
+    {
+        blockCapacities[index] = blockCapacity;
+    }
+
+    Block* blocks = (Block*)salloc::Alloc(chunkSize);
+
+    // Threading the free list writes to every block, which also faults in the pages of the chunk.
+    // Remaining free blocks of the size class are linked after the new ones
+#if defined(SALLOC_HARDENED)
+    Block* head = guard.AddChunk(blocks, blockSize, blockCapacity, freeList[index]);
+#else
+    for (size_t i = 0; i < blockCapacity - 1; ++i)
+    {
+        Block* block = (Block*)((char*)blocks + blockSize * i);
+        Block* next = (Block*)((char*)blocks + blockSize * (i + 1));
+        block->next = next;
+    }
+    Block* last = (Block*)((char*)blocks + blockSize * (blockCapacity - 1));
+    last->next = freeList[index];
+
+    Block* head = blocks;
+#endif
+
+    // Free blocks stay poisoned until allocated
+    sallocPoison(blocks, blockCapacity * blockSize);
+
+    Chunk* newChunk = (Chunk*)salloc::Alloc(sizeof(Chunk));
+    newChunk->capacity = blockCapacity;
+    newChunk->blockSize = blockSize;
+    newChunk->blocks = blocks;
+    newChunk->next = chunks;
+    chunks = newChunk;
+    ++chunkCount;
+
+    freeList[index] = head;
+    freeCounts[index] += blockCapacity;
+}
+
+void* PredefinedBlockAllocator::Reallocate(void* p, size_t oldSize, size_t newSize)
+{
+    if (p == nullptr || newSize == 0 || oldSize == 0)
+    {
+        return Allocator::Reallocate(p, oldSize, newSize);
+    }
+
+    size_t maxBlockSize = sizeMap.MaxBlockSize();
+    if (oldSize > maxBlockSize && newSize > maxBlockSize)
+    {
+        return salloc::Realloc(p, newSize);
+    }
+
+    // Still fits in the same block size class
+    if (oldSize <= maxBlockSize && newSize <= maxBlockSize && sizeMap.values[oldSize] == sizeMap.values[newSize])
+    {
+        sallocPoison(p, oldSize);
+        sallocUnpoison(p, newSize);
+        return p;
+    }
+
+    return Allocator::Reallocate(p, oldSize, newSize);
 }
 
 } // namespace salloc
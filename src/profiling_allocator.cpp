@@ -0,0 +1,86 @@
+#include "salloc/profiling_allocator.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#elif defined(__GLIBC__) || defined(__APPLE__)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#define SALLOC_EXECINFO 1
+#endif
+
+namespace salloc
+{
+
+size_t CaptureStack(void** frames, size_t maxDepth)
+{
+    // Leave out this function
+#if defined(_WIN32)
+    return CaptureStackBackTrace(1, (DWORD)maxDepth, frames, nullptr);
+#elif defined(SALLOC_EXECINFO)
+    void* buffer[64];
+    int depth = backtrace(buffer, int(maxDepth + 1 < 64 ? maxDepth + 1 : 64));
+    if (depth <= 1)
+    {
+        return 0;
+    }
+
+    memcpy(frames, buffer + 1, (depth - 1) * sizeof(void*));
+    return depth - 1;
+#else
+    sallocNotUsed(frames);
+    sallocNotUsed(maxDepth);
+    return 0;
+#endif
+}
+
+void WriteSymbol(FILE* file, void* address)
+{
+#if defined(SALLOC_EXECINFO)
+    Dl_info info;
+    if (dladdr(address, &info) != 0)
+    {
+        if (info.dli_sname)
+        {
+            int status;
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            std::fputs(status == 0 ? demangled : info.dli_sname, file);
+            std::free(demangled);
+            return;
+        }
+
+        if (info.dli_fname)
+        {
+            const char* name = std::strrchr(info.dli_fname, '/');
+            std::fprintf(file, "%s+%#zx", name ? name + 1 : info.dli_fname, (size_t)((char*)address - (char*)info.dli_fbase));
+            return;
+        }
+    }
+#endif
+
+    std::fprintf(file, "%p", address);
+}
+
+void WriteMappedLibraries(FILE* file)
+{
+#if defined(__linux__)
+    FILE* maps = std::fopen("/proc/self/maps", "r");
+    if (maps == nullptr)
+    {
+        return;
+    }
+
+    char buffer[4096];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), maps)) > 0)
+    {
+        std::fwrite(buffer, 1, read, file);
+    }
+    std::fclose(maps);
+#else
+    sallocNotUsed(file);
+#endif
+}
+
+} // namespace salloc
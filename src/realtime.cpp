@@ -0,0 +1,82 @@
+#include "salloc/realtime.h"
+#include "salloc/virtual_memory.h"
+
+namespace salloc
+{
+
+RealtimeBudget::RealtimeBudget(size_t budgetSize)
+    : size{ RoundUpToPage(budgetSize) }
+    , index{ 0 }
+{
+    mem = (char*)ReserveMemory(size);
+    assert(mem != nullptr);
+
+    bool committed = CommitMemory(mem, size);
+    assert(committed);
+    sallocNotUsed(committed);
+
+    // Fault in every page now, so carving never hits a page fault
+    locked = LockMemory(mem, size);
+    memset(mem, 0, size);
+
+    sallocPoison(mem, size);
+}
+
+RealtimeBudget::~RealtimeBudget()
+{
+    sallocUnpoison(mem, size);
+
+    if (locked)
+    {
+        UnlockMemory(mem, size);
+    }
+    ReleaseMemory(mem, size);
+}
+
+void* RealtimeBudget::Allocate(size_t allocationSize, size_t alignment)
+{
+    size_t begin = (index + alignment - 1) / alignment * alignment;
+    if (begin + allocationSize > size)
+    {
+        return nullptr;
+    }
+
+    index = begin + allocationSize;
+
+    sallocUnpoison(mem + begin, allocationSize);
+    return mem + begin;
+}
+
+Chunk* RealtimeBudget::AllocateChunk(size_t blockSize, size_t capacity, size_t minCapacity, size_t alignment)
+{
+    size_t begin = (index + alignment - 1) / alignment * alignment;
+    size_t headerAlignment = alignof(Chunk);
+
+    // Shrink the chunk to what's left
+    if (begin + headerAlignment + sizeof(Chunk) > size)
+    {
+        return nullptr;
+    }
+    size_t maxCapacity = (size - begin - headerAlignment - sizeof(Chunk)) / blockSize;
+    if (capacity > maxCapacity)
+    {
+        capacity = maxCapacity;
+    }
+    if (capacity < minCapacity || capacity == 0)
+    {
+        return nullptr;
+    }
+
+    Block* blocks = (Block*)Allocate(capacity * blockSize, alignment);
+    Chunk* chunk = (Chunk*)Allocate(sizeof(Chunk), headerAlignment);
+    assert(blocks != nullptr && chunk != nullptr);
+
+    chunk->capacity = capacity;
+    chunk->blockSize = blockSize;
+    chunk->blocks = blocks;
+    chunk->next = nullptr;
+
+    return chunk;
+}
+
+} // namespace salloc
@@ -0,0 +1,116 @@
+#include "salloc/ring_allocator.h"
+#include "salloc/virtual_memory.h"
+
+#include <bit>
+
+namespace salloc
+{
+
+RingAllocator::RingAllocator(size_t capacity)
+    : head{ 0 }
+    , cachedTail{ 0 }
+    , tail{ 0 }
+    , cachedHead{ 0 }
+{
+    size_t granularity = GetAllocationGranularity();
+    size_t granules = (capacity + granularity - 1) / granularity;
+    this->capacity = std::bit_ceil(granules < 1 ? size_t(1) : granules) * granularity;
+
+    base = (char*)MapMirroredMemory(this->capacity);
+    assert(base != nullptr);
+
+    // Shadow memory follows addresses, so poison both views
+    sallocPoison(base, 2 * this->capacity);
+}
+
+RingAllocator::~RingAllocator()
+{
+    sallocUnpoison(base, 2 * capacity);
+    UnmapMirroredMemory(base, capacity);
+}
+
+void* RingAllocator::Allocate(size_t size)
+{
+    uint64_t recordSize = header_size + ((size + record_alignment - 1) & ~(record_alignment - 1));
+    if (recordSize > capacity)
+    {
+        return nullptr;
+    }
+
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (h + recordSize - cachedTail > capacity)
+    {
+        // Only look at the consumer's side when the cached view looks full
+        cachedTail = tail.load(std::memory_order_acquire);
+        if (h + recordSize - cachedTail > capacity)
+        {
+            return nullptr;
+        }
+    }
+
+    // Records wrapping past the end continue in the mirror
+    RecordHeader* header = (RecordHeader*)(base + (h & (capacity - 1)));
+    sallocUnpoison(header, header_size + size);
+    header->size = recordSize;
+
+    head.store(h + recordSize, std::memory_order_release);
+
+    return header + 1;
+}
+
+void RingAllocator::Free(void* p, size_t size)
+{
+    sallocNotUsed(size);
+
+    if (p == nullptr)
+    {
+        return;
+    }
+
+    RecordHeader* header = (RecordHeader*)p - 1;
+    assert((header->size & freed_bit) == 0 && header_size + size <= header->size);
+
+    header->size |= freed_bit;
+    sallocPoison(p, header->size - freed_bit - header_size);
+
+    // Reclaim every freed record from the oldest one on
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    uint64_t begin = t;
+    while (true)
+    {
+        if (t == cachedHead)
+        {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t == cachedHead)
+            {
+                break;
+            }
+        }
+
+        RecordHeader* oldest = (RecordHeader*)(base + (t & (capacity - 1)));
+        if ((oldest->size & freed_bit) == 0)
+        {
+            break;
+        }
+
+        t += oldest->size - freed_bit;
+        sallocPoison(oldest, header_size);
+    }
+
+    if (t != begin)
+    {
+        tail.store(t, std::memory_order_release);
+    }
+}
+
+void RingAllocator::Clear()
+{
+    sallocPoison(base, 2 * capacity);
+
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    cachedTail = 0;
+    cachedHead = 0;
+}
+
+} // namespace salloc
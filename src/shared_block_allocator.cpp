@@ -0,0 +1,156 @@
+#include "salloc/shared_block_allocator.h"
+
+#include <new>
+
+namespace salloc
+{
+
+SharedBlockAllocator::SharedBlockAllocator(size_t regionSize, size_t chunkSize, const char* name)
+    : ownsHandle{ true }
+{
+    regionSize = RoundUpToPage(regionSize);
+
+    // Chunks are carved back to back, so they stay aligned to the block unit the offsets are stored in
+    chunkSize = (chunkSize + block_unit - 1) / block_unit * block_unit;
+
+    // Offsets are stored in block units within 32 bits
+    assert(regionSize / block_unit <= UINT32_MAX);
+    assert(header_size + chunkSize <= regionSize && max_block_size <= chunkSize);
+
+    handle = CreateSharedMemory(regionSize, name);
+    assert(handle != invalid_shared_memory);
+
+    base = (char*)MapSharedMemory(handle, regionSize);
+    assert(base != nullptr);
+
+    header = new (base) Header;
+    header->magic = header_magic;
+    header->regionSize = regionSize;
+    header->chunkSize = chunkSize;
+
+    Clear();
+}
+
+SharedBlockAllocator::SharedBlockAllocator(SharedMemoryHandle handle, bool ownsHandle)
+    : handle{ handle }
+    , ownsHandle{ ownsHandle }
+{
+    // Read the region size from the header first
+    size_t headerSize = RoundUpToPage(sizeof(Header));
+    Header* mapped = (Header*)MapSharedMemory(handle, headerSize);
+    assert(mapped != nullptr && mapped->magic == header_magic);
+    size_t regionSize = mapped->regionSize;
+    UnmapSharedMemory(mapped, headerSize);
+
+    base = (char*)MapSharedMemory(handle, regionSize);
+    assert(base != nullptr);
+
+    header = (Header*)base;
+}
+
+SharedBlockAllocator::~SharedBlockAllocator()
+{
+    UnmapSharedMemory(base, header->regionSize);
+
+    if (ownsHandle)
+    {
+        CloseSharedMemory(handle);
+    }
+}
+
+void* SharedBlockAllocator::Allocate(size_t size)
+{
+    if (size == 0 || size > max_block_size)
+    {
+        return nullptr;
+    }
+
+    size_t index = (size - 1) / block_unit;
+    size_t blockSize = (index + 1) * block_unit;
+
+    std::atomic<uint64_t>& list = header->freeList[index];
+
+    while (true)
+    {
+        uint64_t head = list.load(std::memory_order_acquire);
+        uint64_t offset = (head & UINT32_MAX) * block_unit;
+
+        if (offset != 0)
+        {
+            // The block may be taken by another process meanwhile. Then its next offset is stale,
+            // but the tag has moved on and the exchange fails
+            Block* block = (Block*)(base + offset);
+            uint64_t next = (uint64_t)(uintptr_t)block->next;
+
+            if (list.compare_exchange_weak(head, Pack((head >> 32) + 1, next), std::memory_order_acquire))
+            {
+                header->blockCount.fetch_add(1, std::memory_order_relaxed);
+                return block;
+            }
+
+            continue;
+        }
+
+        // Carve a new chunk
+        uint64_t chunkSize = header->chunkSize;
+        uint64_t begin = header->top.fetch_add(chunkSize, std::memory_order_relaxed);
+        if (begin + chunkSize > header->regionSize)
+        {
+            return nullptr;
+        }
+
+        header->chunkCount.fetch_add(1, std::memory_order_relaxed);
+
+        // Build a linked list of offsets for the free list.
+        // Next offsets are stored in place of Block::next
+        size_t blockCapacity = chunkSize / blockSize;
+        for (size_t i = 0; i < blockCapacity - 1; ++i)
+        {
+            Block* block = (Block*)(base + begin + blockSize * i);
+            block->next = (Block*)(uintptr_t)(begin + blockSize * (i + 1));
+        }
+        Block* last = (Block*)(base + begin + blockSize * (blockCapacity - 1));
+
+        Push(index, begin, last);
+    }
+}
+
+void SharedBlockAllocator::Free(void* p, size_t size)
+{
+    if (p == nullptr || size == 0 || size > max_block_size)
+    {
+        return;
+    }
+
+    assert(base + header_size <= (char*)p && (char*)p < base + header->regionSize);
+
+    size_t index = (size - 1) / block_unit;
+
+    Push(index, GetOffset(p), (Block*)p);
+    header->blockCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void SharedBlockAllocator::Push(size_t index, uint64_t first, Block* last)
+{
+    std::atomic<uint64_t>& list = header->freeList[index];
+
+    uint64_t head = list.load(std::memory_order_relaxed);
+    do
+    {
+        last->next = (Block*)(uintptr_t)((head & UINT32_MAX) * block_unit);
+    } while (!list.compare_exchange_weak(head, Pack((head >> 32) + 1, first), std::memory_order_release));
+}
+
+void SharedBlockAllocator::Clear()
+{
+    header->top.store(header_size, std::memory_order_relaxed);
+    header->blockCount.store(0, std::memory_order_relaxed);
+    header->chunkCount.store(0, std::memory_order_relaxed);
+
+    for (size_t i = 0; i < block_size_count; ++i)
+    {
+        header->freeList[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace salloc
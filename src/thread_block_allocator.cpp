@@ -0,0 +1,205 @@
+#include "salloc/thread_block_allocator.h"
+
+#include <new>
+
+namespace salloc
+{
+
+// Remote free list head of a destroyed owner
+static Block* const orphaned_list = (Block*)uintptr_t(1);
+
+ThreadBlockAllocator::ThreadBlockAllocator()
+    : blockCount{ 0 }
+    , segmentCount{ 0 }
+    , segments{ nullptr }
+{
+    memset(freeList, 0, sizeof(freeList));
+
+    shared = new (salloc::Alloc(sizeof(SharedState))) SharedState;
+    shared->remoteFreeList.store(nullptr, std::memory_order_relaxed);
+    shared->orphanCount.store(0, std::memory_order_relaxed);
+    shared->segments = nullptr;
+}
+
+ThreadBlockAllocator::~ThreadBlockAllocator()
+{
+    Collect();
+
+    if (blockCount == 0)
+    {
+        Clear();
+        shared->~SharedState();
+        salloc::Free(shared);
+        return;
+    }
+
+    // Blocks are still out on other threads, leave the segments to the last of them
+    for (Segment* segment = segments; segment; segment = segment->next)
+    {
+        segment->owner.store(nullptr, std::memory_order_relaxed);
+    }
+    shared->segments = segments;
+    shared->orphanCount.store(blockCount, std::memory_order_relaxed);
+
+    // Closing the list hands later remote frees over to ReleaseOrphans, blocks pushed since Collect are counted here
+    Block* block = shared->remoteFreeList.exchange(orphaned_list, std::memory_order_acq_rel);
+    size_t freed = 0;
+    for (; block; block = block->next)
+    {
+        ++freed;
+    }
+
+    if (freed > 0)
+    {
+        ReleaseOrphans(shared, freed);
+    }
+}
+
+void* ThreadBlockAllocator::Allocate(size_t size)
+{
+    if (size == 0)
+    {
+        return nullptr;
+    }
+    if (size > max_block_size)
+    {
+        return salloc::Alloc(size);
+    }
+
+    size_t index = (size - 1) / block_unit;
+    size_t blockSize = (index + 1) * block_unit;
+
+    if (freeList[index] == nullptr)
+    {
+        // Take back blocks freed by other threads before growing
+        Collect();
+    }
+
+    if (freeList[index] == nullptr)
+    {
+        Segment* segment = new (salloc::AlignedAlloc(segment_size, segment_size)) Segment;
+        segment->owner.store(this, std::memory_order_relaxed);
+        segment->shared = shared;
+        segment->blockSize = blockSize;
+        segment->next = segments;
+        segments = segment;
+        ++segmentCount;
+
+        Block* blocks = (Block*)((char*)segment + segment_header_size);
+        size_t blockCapacity = (segment_size - segment_header_size) / blockSize;
+
+        // Build a linked list for the free list.
+        for (size_t i = 0; i < blockCapacity - 1; ++i)
+        {
+            Block* block = (Block*)((char*)blocks + blockSize * i);
+            Block* next = (Block*)((char*)blocks + blockSize * (i + 1));
+            block->next = next;
+        }
+        Block* last = (Block*)((char*)blocks + blockSize * (blockCapacity - 1));
+        last->next = nullptr;
+
+        freeList[index] = blocks;
+    }
+
+    Block* block = freeList[index];
+    freeList[index] = block->next;
+    ++blockCount;
+
+    return block;
+}
+
+void ThreadBlockAllocator::Free(void* p, size_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    if (size > max_block_size)
+    {
+        salloc::Free(p);
+        return;
+    }
+
+    Segment* segment = GetSegment(p);
+    assert(segment->blockSize == ((size - 1) / block_unit + 1) * block_unit);
+
+    Block* block = (Block*)p;
+
+    if (segment->owner.load(std::memory_order_relaxed) == this)
+    {
+        size_t index = (size - 1) / block_unit;
+        block->next = freeList[index];
+        freeList[index] = block;
+        --blockCount;
+        return;
+    }
+
+    // Hand the block over to the owning thread
+    SharedState* owner = segment->shared;
+    Block* head = owner->remoteFreeList.load(std::memory_order_acquire);
+    do
+    {
+        if (head == orphaned_list)
+        {
+            ReleaseOrphans(owner, 1);
+            return;
+        }
+
+        block->next = head;
+    } while (!owner->remoteFreeList.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_acquire));
+}
+
+void ThreadBlockAllocator::Collect()
+{
+    // Take the whole list at once, so the consumer side is free of ABA
+    Block* block = shared->remoteFreeList.exchange(nullptr, std::memory_order_acquire);
+    while (block)
+    {
+        Block* next = block->next;
+
+        size_t index = GetSegment(block)->blockSize / block_unit - 1;
+        block->next = freeList[index];
+        freeList[index] = block;
+        --blockCount;
+
+        block = next;
+    }
+}
+
+void ThreadBlockAllocator::Clear()
+{
+    shared->remoteFreeList.store(nullptr, std::memory_order_relaxed);
+
+    FreeSegments(segments);
+
+    blockCount = 0;
+    segmentCount = 0;
+    segments = nullptr;
+    memset(freeList, 0, sizeof(freeList));
+}
+
+void ThreadBlockAllocator::ReleaseOrphans(SharedState* shared, size_t count)
+{
+    if (shared->orphanCount.fetch_sub(count, std::memory_order_acq_rel) != count)
+    {
+        return;
+    }
+
+    FreeSegments(shared->segments);
+    shared->~SharedState();
+    salloc::Free(shared);
+}
+
+void ThreadBlockAllocator::FreeSegments(Segment* segment)
+{
+    while (segment)
+    {
+        Segment* s0 = segment;
+        segment = s0->next;
+        s0->~Segment();
+        salloc::AlignedFree(s0);
+    }
+}
+
+} // namespace salloc
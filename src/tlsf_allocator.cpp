@@ -0,0 +1,376 @@
+#include "salloc/tlsf_allocator.h"
+
+#include <bit>
+
+namespace salloc
+{
+
+TlsfAllocator::TlsfAllocator(size_t initialPoolSize)
+    : growable{ true }
+    , poolSize{ initialPoolSize }
+    , poolCount{ 0 }
+    , blockCount{ 0 }
+    , freeSize{ 0 }
+    , pools{ nullptr }
+    , flBitmap{ 0 }
+{
+    memset(slBitmap, 0, sizeof(slBitmap));
+    memset(freeLists, 0, sizeof(freeLists));
+}
+
+TlsfAllocator::TlsfAllocator(void* memory, size_t size)
+    : TlsfAllocator(size)
+{
+    growable = false;
+    AddPool(memory, size);
+}
+
+TlsfAllocator::~TlsfAllocator()
+{
+    Pool* pool = pools;
+    while (pool)
+    {
+        Pool* p0 = pool;
+        pool = p0->next;
+        sallocUnpoison(p0, p0->size);
+        if (growable)
+        {
+            salloc::AlignedFree(p0);
+        }
+    }
+}
+
+void* TlsfAllocator::Allocate(size_t size)
+{
+    if (size == 0)
+    {
+        return nullptr;
+    }
+
+    size_t blockSize = (size + align_size - 1) & ~(align_size - 1);
+    if (blockSize < min_block_size)
+    {
+        blockSize = min_block_size;
+    }
+    if (blockSize >= max_block_size)
+    {
+        return nullptr;
+    }
+
+    BlockHeader* block = FindFreeBlock(blockSize);
+    if (block == nullptr)
+    {
+        if (!growable)
+        {
+            return nullptr;
+        }
+
+        // Grow pool size by half, enough for the block and rounded up like a search would
+        poolSize += poolSize / 2;
+        size_t required = blockSize + (blockSize >> sl_index_count_log2) + pool_header_size + 2 * block_header_size;
+        if (required > max_pool_size)
+        {
+            return nullptr;
+        }
+        if (poolSize < required)
+        {
+            poolSize = required;
+        }
+        if (poolSize > max_pool_size)
+        {
+            poolSize = max_pool_size;
+        }
+
+        AddPool(salloc::AlignedAlloc(poolSize, align_size), poolSize);
+
+        block = FindFreeBlock(blockSize);
+        assert(block != nullptr);
+    }
+
+    RemoveFreeBlock(block);
+    block->size &= ~free_bit;
+    freeSize -= GetSize(block);
+    ++blockCount;
+
+    // Free blocks keep all but their links poisoned
+    char* payload = GetPayload(block);
+    sallocUnpoison(payload, GetSize(block));
+
+    Split(block, blockSize);
+
+    sallocPoison(payload + size, GetSize(block) - size);
+
+    return payload;
+}
+
+void TlsfAllocator::Free(void* p, size_t size)
+{
+    if (p == nullptr)
+    {
+        return;
+    }
+
+    BlockHeader* block = GetBlock(p);
+    assert(!IsFree(block) && size <= GetSize(block));
+    sallocNotUsed(size);
+
+    block->size |= free_bit;
+    freeSize += GetSize(block);
+    --blockCount;
+
+    block = Merge(block);
+    InsertFreeBlock(block);
+}
+
+void TlsfAllocator::Clear()
+{
+    flBitmap = 0;
+    memset(slBitmap, 0, sizeof(slBitmap));
+    memset(freeLists, 0, sizeof(freeLists));
+
+    blockCount = 0;
+    freeSize = 0;
+
+    for (Pool* pool = pools; pool; pool = pool->next)
+    {
+        ResetPool(pool);
+    }
+}
+
+void* TlsfAllocator::Reallocate(void* p, size_t oldSize, size_t newSize)
+{
+    if (p == nullptr || newSize == 0)
+    {
+        return Allocator::Reallocate(p, oldSize, newSize);
+    }
+
+    BlockHeader* block = GetBlock(p);
+    size_t blockSize = (newSize + align_size - 1) & ~(align_size - 1);
+    if (blockSize < min_block_size)
+    {
+        blockSize = min_block_size;
+    }
+
+    // Take over the free physical neighbour
+    BlockHeader* next = GetNextPhysical(block);
+    size_t available = GetSize(block);
+    if (available < blockSize && IsFree(next))
+    {
+        available += block_header_size + GetSize(next);
+    }
+
+    if (available < blockSize)
+    {
+        return Allocator::Reallocate(p, oldSize, newSize);
+    }
+
+    if (GetSize(block) < blockSize)
+    {
+        RemoveFreeBlock(next);
+        freeSize -= GetSize(next);
+        sallocUnpoison(next, block_header_size + GetSize(next));
+
+        block->size = available;
+        GetNextPhysical(block)->prevPhysical = block;
+    }
+
+    sallocUnpoison(p, GetSize(block));
+    Split(block, blockSize);
+    sallocPoison((char*)p + newSize, GetSize(block) - newSize);
+
+    return p;
+}
+
+void TlsfAllocator::Mapping(size_t size, size_t* fl, size_t* sl)
+{
+    if (size < small_block_size)
+    {
+        *fl = 0;
+        *sl = size / (small_block_size / sl_index_count);
+    }
+    else
+    {
+        size_t log2 = std::bit_width(size) - 1;
+        *sl = (size >> (log2 - sl_index_count_log2)) ^ (1 << sl_index_count_log2);
+        *fl = log2 - (fl_index_shift - 1);
+    }
+}
+
+TlsfAllocator::BlockHeader* TlsfAllocator::FindFreeBlock(size_t size)
+{
+    // Round up to the next list, so any block found there is large enough
+    if (size >= small_block_size)
+    {
+        size += (size_t(1) << (std::bit_width(size) - 1 - sl_index_count_log2)) - 1;
+    }
+
+    size_t fl, sl;
+    Mapping(size, &fl, &sl);
+    if (fl >= fl_index_count)
+    {
+        return nullptr;
+    }
+
+    uint32_t slMap = slBitmap[fl] & (~0u << sl);
+    if (slMap == 0)
+    {
+        // Next non-empty first level range
+        uint32_t flMap = flBitmap & (~0u << (fl + 1));
+        if (flMap == 0)
+        {
+            return nullptr;
+        }
+
+        fl = std::countr_zero(flMap);
+        slMap = slBitmap[fl];
+    }
+
+    sl = std::countr_zero(slMap);
+    return freeLists[fl][sl];
+}
+
+void TlsfAllocator::InsertFreeBlock(BlockHeader* block)
+{
+    size_t fl, sl;
+    Mapping(GetSize(block), &fl, &sl);
+
+    char* payload = GetPayload(block);
+    sallocUnpoison(payload, min_block_size);
+
+    BlockHeader* head = freeLists[fl][sl];
+    block->nextFree = head;
+    block->prevFree = nullptr;
+    if (head)
+    {
+        head->prevFree = block;
+    }
+
+    freeLists[fl][sl] = block;
+    flBitmap |= 1u << fl;
+    slBitmap[fl] |= 1u << sl;
+
+    sallocPoison(payload + min_block_size, GetSize(block) - min_block_size);
+}
+
+void TlsfAllocator::RemoveFreeBlock(BlockHeader* block)
+{
+    size_t fl, sl;
+    Mapping(GetSize(block), &fl, &sl);
+
+    if (block->prevFree)
+    {
+        block->prevFree->nextFree = block->nextFree;
+    }
+    else
+    {
+        freeLists[fl][sl] = block->nextFree;
+        if (freeLists[fl][sl] == nullptr)
+        {
+            slBitmap[fl] &= ~(1u << sl);
+            if (slBitmap[fl] == 0)
+            {
+                flBitmap &= ~(1u << fl);
+            }
+        }
+    }
+
+    if (block->nextFree)
+    {
+        block->nextFree->prevFree = block->prevFree;
+    }
+}
+
+void TlsfAllocator::Split(BlockHeader* block, size_t size)
+{
+    size_t blockSize = GetSize(block);
+    if (blockSize < size + block_header_size + min_block_size)
+    {
+        return;
+    }
+
+    BlockHeader* remainder = (BlockHeader*)(GetPayload(block) + size);
+    remainder->prevPhysical = block;
+    remainder->size = (blockSize - size - block_header_size) | free_bit;
+    GetNextPhysical(remainder)->prevPhysical = remainder;
+
+    block->size = size;
+
+    freeSize += GetSize(remainder);
+    InsertFreeBlock(Merge(remainder));
+}
+
+TlsfAllocator::BlockHeader* TlsfAllocator::Merge(BlockHeader* block)
+{
+    BlockHeader* prev = block->prevPhysical;
+    if (prev && IsFree(prev))
+    {
+        RemoveFreeBlock(prev);
+        sallocUnpoison(GetPayload(prev), GetSize(prev));
+
+        prev->size += block_header_size + GetSize(block);
+        freeSize += block_header_size;
+        GetNextPhysical(prev)->prevPhysical = prev;
+        block = prev;
+    }
+
+    BlockHeader* next = GetNextPhysical(block);
+    if (IsFree(next))
+    {
+        RemoveFreeBlock(next);
+
+        block->size += block_header_size + GetSize(next);
+        freeSize += block_header_size;
+        GetNextPhysical(block)->prevPhysical = block;
+    }
+
+    return block;
+}
+
+void TlsfAllocator::AddPool(void* memory, size_t size)
+{
+    assert(memory != nullptr);
+
+    // Align the region
+    char* begin = (char*)(((uintptr_t)memory + align_size - 1) & ~(uintptr_t)(align_size - 1));
+    size -= begin - (char*)memory;
+    size &= ~(align_size - 1);
+    assert(size >= pool_header_size + 2 * block_header_size + min_block_size);
+
+    // Blocks of max_block_size and up have no free list, so split the region into pools below it.
+    // A tail too small for a pool is left unused
+    while (size >= pool_header_size + 2 * block_header_size + min_block_size)
+    {
+        size_t chunkSize = size < max_pool_size ? size : max_pool_size;
+
+        Pool* pool = (Pool*)begin;
+        pool->next = pools;
+        pool->size = chunkSize;
+        pools = pool;
+        ++poolCount;
+
+        ResetPool(pool);
+
+        begin += chunkSize;
+        size -= chunkSize;
+    }
+}
+
+void TlsfAllocator::ResetPool(Pool* pool)
+{
+    sallocUnpoison(pool, pool->size);
+
+    // One free block spanning the pool, followed by a used sentinel without payload that stops merging
+    BlockHeader* block = (BlockHeader*)((char*)pool + pool_header_size);
+    block->prevPhysical = nullptr;
+    block->size = (pool->size - pool_header_size - 2 * block_header_size) | free_bit;
+    assert(GetSize(block) < max_block_size);
+
+    BlockHeader* sentinel = GetNextPhysical(block);
+    sentinel->prevPhysical = block;
+    sentinel->size = 0;
+
+    freeSize += GetSize(block);
+    InsertFreeBlock(block);
+}
+
+} // namespace salloc
@@ -0,0 +1,323 @@
+#include "salloc/virtual_memory.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include <cstdio>
+
+namespace salloc
+{
+
+size_t GetPageSize()
+{
+    static size_t pageSize = 0;
+    if (pageSize == 0)
+    {
+#if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        pageSize = info.dwPageSize;
+#else
+        pageSize = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    return pageSize;
+}
+
+size_t GetAllocationGranularity()
+{
+#if defined(_WIN32)
+    static size_t granularity = 0;
+    if (granularity == 0)
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        granularity = info.dwAllocationGranularity;
+    }
+
+    return granularity;
+#else
+    return GetPageSize();
+#endif
+}
+
+void* ReserveMemory(size_t size)
+{
+#if defined(_WIN32)
+    return VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void* p = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+#endif
+}
+
+void ReleaseMemory(void* p, size_t size)
+{
+#if defined(_WIN32)
+    sallocNotUsed(size);
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munmap(p, size);
+#endif
+}
+
+bool CommitMemory(void* p, size_t size)
+{
+#if defined(_WIN32)
+    return VirtualAlloc(p, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+    return mprotect(p, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+void DecommitMemory(void* p, size_t size)
+{
+#if defined(_WIN32)
+    VirtualFree(p, size, MEM_DECOMMIT);
+#else
+    madvise(p, size, MADV_DONTNEED);
+    mprotect(p, size, PROT_NONE);
+#endif
+}
+
+bool LockMemory(void* p, size_t size)
+{
+#if defined(_WIN32)
+    return VirtualLock(p, size) != 0;
+#else
+    return mlock(p, size) == 0;
+#endif
+}
+
+void UnlockMemory(void* p, size_t size)
+{
+#if defined(_WIN32)
+    VirtualUnlock(p, size);
+#else
+    munlock(p, size);
+#endif
+}
+
+bool BindMemory(void* p, size_t size, size_t node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    // Called through syscall() so we don't depend on libnuma
+    constexpr int mpol_bind = 2;
+    constexpr size_t max_node = sizeof(unsigned long) * 8;
+    if (node + 1 >= max_node)
+    {
+        return false;
+    }
+
+    unsigned long nodeMask = 1ul << node;
+    return syscall(SYS_mbind, p, size, mpol_bind, &nodeMask, max_node, 0) == 0;
+#else
+    sallocNotUsed(p);
+    sallocNotUsed(size);
+    sallocNotUsed(node);
+    return false;
+#endif
+}
+
+SharedMemoryHandle CreateSharedMemory(size_t size, const char* name)
+{
+#if defined(_WIN32)
+    HANDLE handle = CreateFileMappingA(
+        INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, name
+    );
+    return handle == nullptr ? invalid_shared_memory : (SharedMemoryHandle)handle;
+#else
+    int fd;
+    if (name)
+    {
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+    else
+    {
+#if defined(__linux__)
+        fd = memfd_create("salloc", MFD_CLOEXEC);
+#else
+        // Unlinked right away, so only the handle refers to it
+        char anonymousName[64];
+        std::snprintf(anonymousName, sizeof(anonymousName), "/salloc-%d-%p", (int)getpid(), (void*)&anonymousName);
+        fd = shm_open(anonymousName, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0)
+        {
+            shm_unlink(anonymousName);
+        }
+#endif
+    }
+
+    if (fd < 0)
+    {
+        return invalid_shared_memory;
+    }
+
+    if (ftruncate(fd, (off_t)size) != 0)
+    {
+        close(fd);
+        return invalid_shared_memory;
+    }
+
+    return fd;
+#endif
+}
+
+SharedMemoryHandle OpenSharedMemory(const char* name)
+{
+#if defined(_WIN32)
+    HANDLE handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+    return handle == nullptr ? invalid_shared_memory : (SharedMemoryHandle)handle;
+#else
+    int fd = shm_open(name, O_RDWR, 0600);
+    return fd < 0 ? invalid_shared_memory : fd;
+#endif
+}
+
+void CloseSharedMemory(SharedMemoryHandle handle)
+{
+#if defined(_WIN32)
+    CloseHandle((HANDLE)handle);
+#else
+    close((int)handle);
+#endif
+}
+
+void UnlinkSharedMemory(const char* name)
+{
+#if defined(_WIN32)
+    sallocNotUsed(name);
+#else
+    shm_unlink(name);
+#endif
+}
+
+void* MapSharedMemory(SharedMemoryHandle handle, size_t size)
+{
+#if defined(_WIN32)
+    return MapViewOfFile((HANDLE)handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, (int)handle, 0);
+    return p == MAP_FAILED ? nullptr : p;
+#endif
+}
+
+void UnmapSharedMemory(void* p, size_t size)
+{
+#if defined(_WIN32)
+    sallocNotUsed(size);
+    UnmapViewOfFile(p);
+#else
+    munmap(p, size);
+#endif
+}
+
+void* MapMirroredMemory(size_t size)
+{
+    SharedMemoryHandle handle = CreateSharedMemory(size);
+    if (handle == invalid_shared_memory)
+    {
+        return nullptr;
+    }
+
+    char* mirrored = nullptr;
+
+#if defined(_WIN32)
+    // Find a free range and map both views into it. Another thread may take the range in between, so retry
+    for (int attempt = 0; attempt < 16 && mirrored == nullptr; ++attempt)
+    {
+        char* p = (char*)VirtualAlloc(nullptr, 2 * size, MEM_RESERVE, PAGE_NOACCESS);
+        if (p == nullptr)
+        {
+            break;
+        }
+        VirtualFree(p, 0, MEM_RELEASE);
+
+        void* first = MapViewOfFileEx((HANDLE)handle, FILE_MAP_ALL_ACCESS, 0, 0, size, p);
+        void* second = first ? MapViewOfFileEx((HANDLE)handle, FILE_MAP_ALL_ACCESS, 0, 0, size, p + size) : nullptr;
+        if (second)
+        {
+            mirrored = p;
+        }
+        else if (first)
+        {
+            UnmapViewOfFile(first);
+        }
+    }
+#else
+    char* p = (char*)ReserveMemory(2 * size);
+    if (p)
+    {
+        void* first = mmap(p, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, (int)handle, 0);
+        void* second = mmap(p + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, (int)handle, 0);
+        if (first == p && second == p + size)
+        {
+            mirrored = p;
+        }
+        else
+        {
+            munmap(p, 2 * size);
+        }
+    }
+#endif
+
+    // The mappings keep the memory alive
+    CloseSharedMemory(handle);
+
+    return mirrored;
+}
+
+void UnmapMirroredMemory(void* p, size_t size)
+{
+#if defined(_WIN32)
+    UnmapViewOfFile(p);
+    UnmapViewOfFile((char*)p + size);
+#else
+    munmap(p, 2 * size);
+#endif
+}
+
+bool MapFile(const char* path, void* p, size_t size)
+{
+#if defined(_WIN32)
+    if (!CommitMemory(p, RoundUpToPage(size)))
+    {
+        return false;
+    }
+
+    FILE* file = std::fopen(path, "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    size_t read = std::fread(p, 1, size, file);
+    std::fclose(file);
+
+    return read == size;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    void* mapped = mmap(p, RoundUpToPage(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    close(fd);
+
+    return mapped == p;
+#endif
+}
+
+} // namespace salloc
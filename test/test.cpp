@@ -2,13 +2,76 @@
 #include "doctest.h"
 
 #include "block_allocator.h"
+#include "buddy_allocator.h"
+#include "double_ended_stack_allocator.h"
 #include "fixed_block_allocator.h"
+#include "handle_pool.h"
+#include "instrumentation.h"
 #include "linear_allocator.h"
+#include "node_pool_resource.h"
+#include "numa_block_allocator.h"
+#include "numa_fixed_block_allocator.h"
+#include "object_pool.h"
+#include "persistent_fixed_block_allocator.h"
 #include "predefined_block_allocator.h"
+#include "profiling_allocator.h"
+#include "ring_allocator.h"
+#include "shared_block_allocator.h"
 #include "stack_allocator.h"
+#include "static_predefined_block_allocator.h"
+#include "stl_allocator.h"
+#include "thread_block_allocator.h"
+#include "tlsf_allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <map>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 using namespace salloc;
 
+#if defined(__linux__)
+// Runs the function in a child process and returns its wait status
+template <typename Function>
+int RunInChild(Function&& function)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // The child is expected to crash, keep doctest's handlers and reports out of it
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        std::signal(SIGSEGV, SIG_DFL);
+        std::signal(SIGBUS, SIG_DFL);
+        std::signal(SIGABRT, SIG_DFL);
+
+        function();
+        _exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    return status;
+}
+
+template <typename Function>
+bool Aborts(Function&& function)
+{
+    int status = RunInChild(function);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+#endif
+
 TEST_CASE("Allocators")
 {
 #if defined(_WIN32) && defined(_DEBUG)
@@ -34,6 +97,44 @@ TEST_CASE("Stack allocator")
     sa.Clear();
 }
 
+TEST_CASE("Double ended stack allocator")
+{
+    constexpr size_t stackSize = 4096;
+    DoubleEndedStackAllocator<stackSize> desa;
+
+    // Ends grow towards each other
+    char* b0 = (char*)desa.AllocateBottom(1000);
+    char* t0 = (char*)desa.AllocateTop(1000);
+    char* b1 = (char*)desa.AllocateBottom(1000);
+    char* t1 = (char*)desa.AllocateTop(500);
+    REQUIRE_LT(b0, b1);
+    REQUIRE_LT(b1, t1);
+    REQUIRE_LT(t1, t0);
+    REQUIRE_EQ(desa.GetBottomAllocation(), 2000);
+    REQUIRE_EQ(desa.GetTopAllocation(), 1500);
+
+    // Budget is shared, so this spills out to the upstream allocator
+    char* t2 = (char*)desa.AllocateTop(1000);
+    REQUIRE((t2 < b0 || t2 >= t0 + 1000));
+
+    memset(b1, 1, 1000);
+    memset(t1, 2, 500);
+    REQUIRE_EQ(b1[999], 1);
+
+    // Per frame temporaries go away without touching the bottom
+    desa.ClearTop();
+    REQUIRE_EQ(desa.GetTopAllocation(), 0);
+    REQUIRE_EQ(desa.GetBottomAllocation(), 2000);
+    REQUIRE_EQ(desa.AllocateTop(1000), t0);
+    desa.FreeTop(t0, 1000);
+
+    REQUIRE_EQ(desa.GetMaxAllocation(), 4500);
+
+    desa.FreeBottom(b1, 1000);
+    desa.Free(b0, 1000);
+    REQUIRE_EQ(desa.GetAllocation(), 0);
+}
+
 TEST_CASE("Linear allocator")
 {
     LinearAllocator la;
@@ -55,6 +156,108 @@ TEST_CASE("Linear allocator")
     la.Clear();
 }
 
+TEST_CASE("Reserved linear allocator")
+{
+    constexpr size_t commitSize = 64 * 1024;
+    LinearAllocator la{ LinearReservation{ 64 * 1024 * 1024, commitSize } };
+    REQUIRE_EQ(la.GetCapacity(), 64 * 1024 * 1024);
+    REQUIRE_EQ(la.GetCommittedSize(), 0);
+
+    // Grows in use, and earlier allocations never move
+    std::vector<char*> blocks;
+    for (int i = 0; i < 1024; i++)
+    {
+        char* p = (char*)la.Allocate(1024);
+        REQUIRE_NE(p, nullptr);
+        p[0] = (char)i;
+        blocks.push_back(p);
+    }
+    REQUIRE_EQ(blocks.back(), blocks.front() + 1023 * (1024 + redzone_size));
+    REQUIRE_EQ(blocks.front()[0], 0);
+    size_t committed = la.GetCommittedSize();
+    REQUIRE_GE(committed, 1024 * 1024);
+    REQUIRE_EQ(committed % commitSize, 0);
+
+    // Past the reservation
+    REQUIRE_EQ(la.Allocate(64 * 1024 * 1024), nullptr);
+
+    for (int i = 1023; i >= 0; i--)
+    {
+        la.Free(blocks[i], 1024);
+    }
+
+    // Keeps the peak of the last round
+    la.Clear();
+    REQUIRE_EQ(la.GetCommittedSize(), committed);
+
+    void* p = la.Allocate(1000);
+    REQUIRE_EQ(p, blocks.front());
+    REQUIRE_EQ(la.Reallocate(p, 1000, 100 * 1024), p);
+    la.Free(p, 100 * 1024);
+
+    // Decommitted down to the smaller peak
+    la.Clear();
+    REQUIRE_EQ(la.GetCommittedSize(), 2 * commitSize);
+    REQUIRE_FALSE(la.GrowMemory());
+}
+
+TEST_CASE("Guarded linear allocator")
+{
+    size_t pageSize = GetPageSize();
+
+#if defined(__linux__)
+    // Runs the access in a child process, which must not survive it
+    auto faults = [](auto access) {
+        int status = RunInChild(access);
+        return !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    };
+#endif
+
+    SUBCASE("Guard page")
+    {
+        LinearAllocator la{ LinearReservation{ 1024 * 1024, 0, GuardMode::guard_page } };
+
+        char* p = (char*)la.Allocate(100);
+        REQUIRE_EQ(la.GetCommittedSize(), pageSize);
+
+#if defined(__linux__)
+        REQUIRE(faults([&]() { ((volatile char*)p)[pageSize] = 1; }));
+#endif
+
+        la.Free(p, 100);
+    }
+
+    SUBCASE("Electric fence")
+    {
+        LinearAllocator la{ LinearReservation{ 1024 * 1024, 0, GuardMode::electric_fence } };
+
+        // Allocations end flush against a page boundary
+        char* a = (char*)la.Allocate(100);
+        char* b = (char*)la.Allocate(pageSize + 1);
+        REQUIRE_EQ((uintptr_t)(a + 100) % pageSize, 0);
+        REQUIRE_EQ((uintptr_t)(b + pageSize + 1) % pageSize, 0);
+        REQUIRE_GE(b, a + 100 + pageSize);
+
+        memset(b, 1, pageSize + 1);
+        b = (char*)la.Reallocate(b, pageSize + 1, 10);
+        REQUIRE_EQ(b[9], 1);
+        REQUIRE_EQ((uintptr_t)(b + 10) % pageSize, 0);
+
+#if defined(__linux__)
+        REQUIRE(faults([&]() { ((volatile char*)a)[100] = 1; }));
+#endif
+
+        la.Free(b, 10);
+
+#if defined(__linux__)
+        // Use after free
+        REQUIRE(faults([&]() { sallocNotUsed(((volatile char*)b)[0]); }));
+#endif
+
+        la.Free(a, 100);
+    }
+}
+
 TEST_CASE("Fixed block allocator")
 {
     struct Vec2
@@ -124,6 +327,49 @@ TEST_CASE("Predefined block allocator")
 
     REQUIRE_EQ(pba.GetChunkCount(), pba.GetBlockSizeCount()); // Not changed
     REQUIRE_EQ(pba.GetBlockCount(), pba.GetBlockSizeCount() + 3);
+
+    // Chunks grow per size class
+    size_t chunkSize16 = pba.GetChunkSize(16);
+    size_t chunkSize640 = pba.GetChunkSize(640);
+
+    for (size_t i = 0; i < 1000; i++)
+    {
+        pba.Allocate(640);
+    }
+
+    REQUIRE_GT(pba.GetChunkSize(640), chunkSize640);
+    REQUIRE_EQ(pba.GetChunkSize(16), chunkSize16);
+}
+
+TEST_CASE("Static predefined block allocator")
+{
+    using StaticAllocator = StaticPredefinedBlockAllocator<16, 32, 64, 96, 128, 160, 192, 224, 256, 320, 384, 448, 512, 640>;
+
+    static_assert(StaticAllocator::GetBlockSizeIndex(1) == 0);
+    static_assert(StaticAllocator::GetBlockSizeIndex(16) == 0);
+    static_assert(StaticAllocator::GetBlockSizeIndex(17) == 1);
+    static_assert(StaticAllocator::GetBlockSizeIndex(640) == StaticAllocator::block_size_count - 1);
+
+    StaticAllocator spba;
+
+    for (size_t size : StaticAllocator::block_sizes)
+    {
+        spba.Allocate(size);
+    }
+
+    REQUIRE_EQ(spba.GetChunkCount(), StaticAllocator::block_size_count);
+    REQUIRE_EQ(spba.GetBlockCount(), StaticAllocator::block_size_count);
+
+    // Allocations fit in exsiting memory block
+    void* m = spba.Allocate(17);
+    spba.Allocate(18);
+    spba.Allocate(19);
+
+    REQUIRE_EQ(spba.GetChunkCount(), StaticAllocator::block_size_count);
+    REQUIRE_EQ(spba.GetBlockCount(), StaticAllocator::block_size_count + 3);
+
+    spba.Free(m, 17);
+    REQUIRE_EQ(spba.Allocate(32), m);
 }
 
 TEST_CASE("Block allocator")
@@ -200,3 +446,1194 @@ TEST_CASE("New Delete")
 
     REQUIRE_EQ(ba.GetChunkCount(), 0);
 }
+
+TEST_CASE("Reallocate")
+{
+    BlockAllocator ba;
+
+    // Stays in the same size class
+    void* m = ba.Allocate(17);
+    REQUIRE_EQ(ba.Reallocate(m, 17, 24), m);
+
+    memset(m, 7, 24);
+    void* n = ba.Reallocate(m, 24, 100);
+    REQUIRE_NE(n, m);
+    REQUIRE_EQ(((char*)n)[23], 7);
+    REQUIRE_EQ(ba.GetBlockCount(), 1);
+
+    ba.Free(n, 100);
+
+    LinearAllocator la;
+
+    m = la.Allocate(16);
+    n = la.Allocate(16);
+    REQUIRE_EQ(la.Reallocate(n, 16, 128), n);
+    REQUIRE_EQ(la.GetAllocation(), 144);
+
+    la.Free(n, 128);
+    la.Free(m, 16);
+
+    StackAllocator<2048> sa;
+
+    m = sa.Allocate(512);
+    REQUIRE_EQ(sa.Reallocate(m, 512, 1024), m);
+
+    // Spills out to the upstream allocator
+    memset(m, 7, 1024);
+    n = sa.Reallocate(m, 1024, 4096);
+    REQUIRE_NE(n, m);
+    REQUIRE_EQ(((char*)n)[1023], 7);
+    REQUIRE_EQ(sa.GetAllocation(), 4096);
+
+#if !defined(SALLOC_ASAN) && !defined(__SANITIZE_THREAD__)
+    // A failed upstream realloc leaves the allocation as it is
+    volatile size_t huge = SIZE_MAX / 2;
+    REQUIRE_EQ(sa.Reallocate(n, 4096, huge), nullptr);
+    REQUIRE_EQ(((char*)n)[1023], 7);
+    REQUIRE_EQ(sa.GetAllocation(), 4096);
+#endif
+
+    sa.Free(n, 4096);
+}
+
+TEST_CASE("STL allocator")
+{
+    BlockAllocator ba;
+
+    {
+        std::vector<int, StlAllocator<int, BlockAllocator>> v(ba);
+        for (int i = 0; i < 100; ++i)
+        {
+            v.push_back(i);
+        }
+        REQUIRE_EQ(v[99], 99);
+        REQUIRE_EQ(ba.GetBlockCount(), 1);
+
+        // Rebound to the node type, still drawing from the same allocator
+        std::map<int, int, std::less<int>, StlAllocator<std::pair<const int, int>, BlockAllocator>> m(ba);
+        size_t blockCount = ba.GetBlockCount();
+        for (int i = 0; i < 100; ++i)
+        {
+            m[i] = i * 2;
+        }
+        REQUIRE_EQ(m[50], 100);
+        REQUIRE_EQ(ba.GetBlockCount(), blockCount + 100);
+
+        std::map<int, int, std::less<int>, StlAllocator<std::pair<const int, int>, BlockAllocator>> copy(m);
+        REQUIRE_EQ(copy.get_allocator(), m.get_allocator());
+        REQUIRE_GE(ba.GetBlockCount(), blockCount + 200);
+    }
+    REQUIRE_EQ(ba.GetBlockCount(), 0);
+
+    // Through the interface
+    LinearAllocator la;
+    {
+        std::list<int, StlAllocator<int>> l(la);
+        l.push_back(1);
+        l.push_back(2);
+        REQUIRE_EQ(l.back(), 2);
+        REQUIRE_GT(la.GetAllocation(), 2 * sizeof(int));
+        l.pop_back();
+        l.pop_back();
+    }
+    REQUIRE_EQ(la.GetAllocation(), 0);
+
+    // Odd sized allocations keep the next one aligned
+    StlAllocator<char, LinearAllocator> chars(la);
+    StlAllocator<double, LinearAllocator> doubles(la);
+    char* c = chars.allocate(3);
+    double* d = doubles.allocate(1);
+    REQUIRE_EQ((uintptr_t)d % alignof(double), 0);
+    doubles.deallocate(d, 1);
+    chars.deallocate(c, 3);
+    REQUIRE_EQ(la.GetAllocation(), 0);
+}
+
+TEST_CASE("Node pool resource")
+{
+    NodePoolResource npr;
+
+    {
+        std::map<int, int, std::less<int>, StlAllocator<std::pair<const int, int>, NodePoolResource>> m(npr);
+        std::vector<int, StlAllocator<int, NodePoolResource>> v(npr);
+        v.reserve(100);
+        for (int i = 0; i < 100; ++i)
+        {
+            m[i] = i;
+            v.push_back(i);
+        }
+        REQUIRE_EQ(npr.GetNodeCount(), 100);
+        REQUIRE_EQ(npr.GetPoolCount(), 1);
+
+        // Nodes inserted one after another are adjacent, with vector storage kept apart
+        const char* previous = nullptr;
+        ptrdiff_t stride = 0;
+        for (const auto& pair : m)
+        {
+            const char* current = (const char*)&pair;
+            if (previous && stride == 0)
+            {
+                stride = current - previous;
+            }
+            else if (previous)
+            {
+                REQUIRE_EQ(current - previous, stride);
+            }
+            previous = current;
+        }
+        REQUIRE_GT(stride, 0);
+        REQUIRE_LE(stride, NodePoolResource::max_node_size);
+
+        m.erase(50);
+        REQUIRE_EQ(npr.GetNodeCount(), 99);
+
+        // Freed nodes are reused first
+        const char* erased = (const char*)&*m.find(49) + stride;
+        m[1000] = 0;
+        REQUIRE_EQ((const char*)&*m.find(1000), erased);
+    }
+    REQUIRE_EQ(npr.GetNodeCount(), 0);
+    REQUIRE_EQ(npr.GetUpstream().GetBlockCount(), 0);
+}
+
+TEST_CASE("Profiling allocator")
+{
+    SUBCASE("Every allocation")
+    {
+        ProfilingAllocator<BlockAllocator> pa{ 0 };
+
+        void* a = pa.Allocate(100);
+        void* b = pa.Allocate(200);
+        void* c = pa.Allocate(300);
+        REQUIRE_EQ(pa.GetSampleCount(), 3);
+        REQUIRE_EQ(pa.GetEstimatedSize(), 600);
+        REQUIRE_EQ(pa.GetInner().GetBlockCount(), 3);
+
+        pa.Free(b, 200);
+        REQUIRE_EQ(pa.GetSampleCount(), 2);
+
+        // Stays sampled when moved
+        c = pa.Reallocate(c, 300, 2000);
+        REQUIRE_EQ(pa.GetSampleCount(), 2);
+        REQUIRE_EQ(pa.GetEstimatedSize(), 2100);
+
+        FILE* file = std::tmpfile();
+        REQUIRE_NE(file, nullptr);
+        pa.WriteCollapsedStacks(file);
+        std::rewind(file);
+
+        // One line per distinct stack, each ending in its byte count
+        char line[4096];
+        size_t total = 0;
+        int lines = 0;
+        while (std::fgets(line, sizeof(line), file))
+        {
+            const char* count = std::strrchr(line, ' ');
+            REQUIRE_NE(count, nullptr);
+            total += std::strtoull(count + 1, nullptr, 10);
+            ++lines;
+        }
+        std::fclose(file);
+        REQUIRE_EQ(total, 2100);
+        REQUIRE_GE(lines, 1);
+
+        file = std::tmpfile();
+        pa.WriteHeapProfile(file);
+        std::rewind(file);
+        REQUIRE_NE(std::fgets(line, sizeof(line), file), nullptr);
+        REQUIRE_EQ(std::strncmp(line, "heap profile:", 13), 0);
+        REQUIRE_NE(std::strstr(line, "heap_v2/1"), nullptr);
+        std::fclose(file);
+
+        pa.Free(a, 100);
+        pa.Free(c, 2000);
+        REQUIRE_EQ(pa.GetSampleCount(), 0);
+    }
+
+    SUBCASE("Sampled")
+    {
+        ProfilingAllocator<BlockAllocator> pa{ 4096 };
+
+        std::vector<void*> blocks;
+        for (int i = 0; i < 10000; i++)
+        {
+            blocks.push_back(pa.Allocate(64));
+        }
+
+        // About one sample per interval, scaled back up to the live size
+        size_t live = 10000 * 64;
+        REQUIRE_LT(pa.GetSampleCount(), 1000);
+        REQUIRE_GT(pa.GetEstimatedSize(), live * 7 / 10);
+        REQUIRE_LT(pa.GetEstimatedSize(), live * 13 / 10);
+
+        for (void* p : blocks)
+        {
+            pa.Free(p, 64);
+        }
+        REQUIRE_EQ(pa.GetSampleCount(), 0);
+        REQUIRE_EQ(pa.GetEstimatedSize(), 0);
+    }
+}
+
+TEST_CASE("TLSF allocator")
+{
+    SUBCASE("Fixed region")
+    {
+        static char region[64 * 1024];
+        TlsfAllocator tlsf{ region, sizeof(region) };
+        size_t freeSize = tlsf.GetFreeSize();
+
+        std::vector<char*> buffers;
+        for (size_t i = 0; i < 16; i++)
+        {
+            size_t size = 1024 + i * 100;
+            char* p = (char*)tlsf.Allocate(size);
+            REQUIRE_NE(p, nullptr);
+            REQUIRE_EQ((uintptr_t)p % TlsfAllocator::align_size, 0);
+            memset(p, (int)i, size);
+            buffers.push_back(p);
+        }
+        REQUIRE_EQ(tlsf.GetBlockCount(), 16);
+
+        // Free every other buffer, then the rest so neighbours merge back into one block
+        for (size_t i = 0; i < 16; i += 2)
+        {
+            REQUIRE_EQ(buffers[i][0], (char)i);
+            tlsf.Free(buffers[i], 1024 + i * 100);
+        }
+        for (size_t i = 1; i < 16; i += 2)
+        {
+            tlsf.Free(buffers[i], 1024 + i * 100);
+        }
+        REQUIRE_EQ(tlsf.GetBlockCount(), 0);
+        REQUIRE_EQ(tlsf.GetFreeSize(), freeSize);
+
+        // Merged back into one block, searches round up to the next list so leave room for that
+        size_t largest = freeSize - freeSize / TlsfAllocator::sl_index_count;
+        void* p = tlsf.Allocate(largest);
+        REQUIRE_NE(p, nullptr);
+        REQUIRE_EQ(tlsf.Allocate(freeSize / 2), nullptr);
+        tlsf.Free(p, largest);
+
+        // Freed block is reused
+        char* a = (char*)tlsf.Allocate(4096);
+        tlsf.Free(a, 4096);
+        REQUIRE_EQ(tlsf.Allocate(4096), a);
+
+        // Grows in place into the free neighbour
+        REQUIRE_EQ(tlsf.Reallocate(a, 4096, 8192), a);
+
+        tlsf.Clear();
+        REQUIRE_EQ(tlsf.GetFreeSize(), freeSize);
+    }
+
+    SUBCASE("Growable")
+    {
+        TlsfAllocator tlsf{ 64 * 1024 };
+
+        std::vector<std::pair<void*, size_t>> buffers;
+        for (size_t i = 0; i < 100; i++)
+        {
+            size_t size = 1024 << (i % 6);
+            buffers.emplace_back(tlsf.Allocate(size), size);
+            REQUIRE_NE(buffers.back().first, nullptr);
+        }
+        REQUIRE_GT(tlsf.GetPoolCount(), 1);
+
+        // Larger than any pool so far
+        void* large = tlsf.Allocate(1024 * 1024);
+        REQUIRE_NE(large, nullptr);
+        tlsf.Free(large, 1024 * 1024);
+
+        for (auto [p, size] : buffers)
+        {
+            tlsf.Free(p, size);
+        }
+        REQUIRE_EQ(tlsf.GetBlockCount(), 0);
+
+        // Would need a pool with a block past the largest free list
+        size_t poolCount = tlsf.GetPoolCount();
+        REQUIRE_EQ(tlsf.Allocate(TlsfAllocator::max_block_size - 4096), nullptr);
+        REQUIRE_EQ(tlsf.GetPoolCount(), poolCount);
+    }
+
+    SUBCASE("Region larger than a pool")
+    {
+        // Reserved address space, only the pool headers and sentinels get touched
+        size_t size = TlsfAllocator::max_pool_size + TlsfAllocator::max_pool_size / 4;
+        void* region = ReserveMemory(size);
+        REQUIRE_NE(region, nullptr);
+        REQUIRE(CommitMemory(region, size));
+        {
+            TlsfAllocator tlsf{ region, size };
+            REQUIRE_EQ(tlsf.GetPoolCount(), 2);
+            REQUIRE_GT(tlsf.GetFreeSize(), TlsfAllocator::max_pool_size);
+
+            void* p = tlsf.Allocate(1024 * 1024);
+            REQUIRE_NE(p, nullptr);
+            tlsf.Free(p, 1024 * 1024);
+        }
+        ReleaseMemory(region, size);
+    }
+}
+
+TEST_CASE("Buddy allocator")
+{
+    constexpr size_t kb = 1024;
+    BuddyAllocator ba{ 1024 * kb, 4 * kb };
+    REQUIRE_EQ(ba.GetOrderCount(), 9);
+    REQUIRE_EQ(ba.GetOrder(1), 0);
+    REQUIRE_EQ(ba.GetOrder(4 * kb + 1), 1);
+    REQUIRE_EQ(ba.GetFragmentation(), 0.0);
+
+    // Splits the region down to one block of each order
+    char* a = (char*)ba.Allocate(3 * kb);
+    REQUIRE_NE(a, nullptr);
+    for (size_t order = 0; order < ba.GetOrderCount() - 1; ++order)
+    {
+        REQUIRE_EQ(ba.GetStats(order).freeCount, 1);
+    }
+    REQUIRE_EQ(ba.GetStats(0).usedCount, 1);
+    REQUIRE_EQ(ba.GetFreeSize(), 1020 * kb);
+
+    // Buddy of a
+    char* b = (char*)ba.Allocate(4 * kb);
+    REQUIRE_EQ(b, a + 4 * kb);
+
+    char* c = (char*)ba.Allocate(100 * kb);
+    REQUIRE_EQ((c - a) % (128 * kb), 0);
+    REQUIRE_EQ(ba.GetStats(5).usedCount, 1);
+    REQUIRE_GT(ba.GetFragmentation(), 0.0);
+
+    // Split state lives outside the blocks, so all of their contents belong to the caller
+    memset(a, 0xff, 3 * kb);
+    memset(b, 0xff, 4 * kb);
+
+    REQUIRE_EQ(ba.Reallocate(a, 3 * kb, 4 * kb), a);
+
+    ba.Free(a, 4 * kb);
+    ba.Free(c, 100 * kb);
+    ba.Free(b, 4 * kb);
+
+    // Merged back into the whole region
+    REQUIRE_EQ(ba.GetStats(ba.GetOrderCount() - 1).freeCount, 1);
+    REQUIRE_EQ(ba.GetFreeSize(), 1024 * kb);
+    REQUIRE_EQ(ba.GetFragmentation(), 0.0);
+
+    void* all = ba.Allocate(1024 * kb);
+    REQUIRE_EQ(all, a);
+    REQUIRE_EQ(ba.Allocate(1), nullptr);
+    ba.Free(all, 1024 * kb);
+
+    // Exhaust the smallest order
+    std::vector<void*> blocks;
+    while (void* p = ba.Allocate(4 * kb))
+    {
+        blocks.push_back(p);
+    }
+    REQUIRE_EQ(blocks.size(), 256);
+    REQUIRE_EQ(ba.GetFreeSize(), 0);
+
+    ba.Clear();
+    REQUIRE_EQ(ba.GetLargestFreeBlock(), 1024 * kb);
+}
+
+TEST_CASE("Cache line placement")
+{
+    BlockAllocator ba;
+
+    char* a = (char*)ba.Allocate(24, BlockPlacement::cache_line_aligned);
+    char* b = (char*)ba.Allocate(24, BlockPlacement::cache_line_aligned);
+
+    REQUIRE_EQ((size_t)a % BlockAllocator::cache_line_size, 0);
+    REQUIRE_EQ((size_t)b % BlockAllocator::cache_line_size, 0);
+#if defined(SALLOC_HARDENED)
+    // Shuffled free lists only keep the alignment
+    REQUIRE_EQ((b - a) % BlockAllocator::cache_line_size, 0);
+#else
+    REQUIRE_EQ(b - a, BlockAllocator::cache_line_size);
+#endif
+
+    char* c = (char*)ba.Allocate(24, BlockPlacement::cache_line_isolated);
+    char* d = (char*)ba.Allocate(24, BlockPlacement::cache_line_isolated);
+
+#if defined(SALLOC_HARDENED)
+    REQUIRE_EQ((d - c) % (2 * BlockAllocator::cache_line_size), 0);
+#else
+    REQUIRE_EQ(d - c, 2 * BlockAllocator::cache_line_size);
+#endif
+    REQUIRE_EQ(ba.GetBlockCount(), 4);
+
+    ba.Free(a, 24, BlockPlacement::cache_line_aligned);
+    ba.Free(c, 24, BlockPlacement::cache_line_isolated);
+
+    REQUIRE_EQ(ba.Allocate(24, BlockPlacement::cache_line_aligned), a);
+    REQUIRE_EQ(ba.Allocate(24, BlockPlacement::cache_line_isolated), c);
+
+    ba.Clear();
+    REQUIRE_EQ(ba.GetChunkCount(), 0);
+}
+
+TEST_CASE("Reserve")
+{
+    BlockAllocator ba;
+    size_t chunkSize = ba.GetChunkSize(32);
+
+    // Gets a chunk of its own size, later chunks keep growing from the initial size
+    ba.Reserve(32, 1000);
+    REQUIRE_EQ(ba.GetChunkCount(), 1);
+    REQUIRE_GE(ba.GetFreeCount(32), 1000);
+    REQUIRE_EQ(ba.GetChunkSize(32), chunkSize);
+
+    // No chunk is created while the reserved blocks last
+    size_t freeCount = ba.GetFreeCount(32);
+    for (size_t i = 0; i < freeCount; ++i)
+    {
+        ba.Allocate(32);
+    }
+    REQUIRE_EQ(ba.GetChunkCount(), 1);
+    REQUIRE_EQ(ba.GetFreeCount(32), 0);
+
+    ba.SetWatermark(32, 100);
+    ba.Replenish();
+    REQUIRE_EQ(ba.GetChunkCount(), 2);
+    REQUIRE_GE(ba.GetFreeCount(32), 100);
+    REQUIRE_EQ(ba.GetChunkSize(32), chunkSize + chunkSize / 2);
+
+    PredefinedBlockAllocator pba;
+
+    Reservation profile[] = { { 16, 500 }, { 100, 200 }, { 640, 10 } };
+    pba.Prewarm(profile);
+    REQUIRE_EQ(pba.GetChunkCount(), 3);
+    REQUIRE_GE(pba.GetFreeCount(16), 500);
+    REQUIRE_GE(pba.GetFreeCount(128), 200);
+    REQUIRE_GE(pba.GetFreeCount(640), 10);
+
+    // Already reserved
+    pba.Reserve(16, 500);
+    REQUIRE_EQ(pba.GetChunkCount(), 3);
+
+    void* m = pba.Allocate(100);
+    REQUIRE_EQ(pba.GetChunkCount(), 3);
+    pba.Free(m, 100);
+
+    pba.SetWatermark(64, 50);
+    pba.Replenish();
+    REQUIRE_EQ(pba.GetChunkCount(), 4);
+    REQUIRE_GE(pba.GetFreeCount(64), 50);
+
+    chunkSize = pba.GetChunkSize(32);
+    pba.Reserve(32, 10000);
+    REQUIRE_GE(pba.GetFreeCount(32), 10000);
+    REQUIRE_EQ(pba.GetChunkSize(32), chunkSize);
+}
+
+TEST_CASE("Background refill")
+{
+    // Chunks grow by half, the first one included
+    size_t initialChunkSize = 16 * 1024;
+    size_t firstChunkSize = initialChunkSize + initialChunkSize / 2;
+    size_t nextChunkSize = firstChunkSize + firstChunkSize / 2;
+
+    BlockAllocator ba{ initialChunkSize };
+    ba.StartBackgroundRefill();
+
+    std::vector<void*> blocks;
+    blocks.push_back(ba.Allocate(32));
+    REQUIRE_FALSE(ba.IsChunkReady(32));
+
+    // Drain the free list below half of the next chunk
+    while (ba.GetFreeCount(32) >= nextChunkSize / 32 / 2)
+    {
+        blocks.push_back(ba.Allocate(32));
+    }
+
+    ba.WaitForChunk(32);
+    REQUIRE(ba.IsChunkReady(32));
+    REQUIRE_EQ(ba.GetChunkCount(), 1);
+
+    // The prepared chunk is spliced in once the free list runs dry
+    while (ba.GetFreeCount(32) > 0)
+    {
+        blocks.push_back(ba.Allocate(32));
+    }
+    blocks.push_back(ba.Allocate(32));
+    REQUIRE_EQ(ba.GetChunkCount(), 2);
+    REQUIRE_EQ(ba.GetChunkSize(32), nextChunkSize);
+
+    for (void* block : blocks)
+    {
+        ba.Free(block, 32);
+    }
+    REQUIRE_EQ(ba.GetBlockCount(), 0);
+
+    // Clear with the thread running discards the prepared chunk
+    blocks.clear();
+    while (ba.GetFreeCount(32) > 0)
+    {
+        blocks.push_back(ba.Allocate(32));
+    }
+    ba.WaitForChunk(32);
+    ba.Clear();
+    REQUIRE_FALSE(ba.IsChunkReady(32));
+    REQUIRE_EQ(ba.GetChunkCount(), 0);
+
+    ba.Free(ba.Allocate(32), 32);
+    REQUIRE_EQ(ba.GetChunkCount(), 1);
+    REQUIRE_FALSE(ba.IsChunkReady(32));
+
+    ba.StopBackgroundRefill();
+}
+
+static size_t upstreamCalls = 0;
+static size_t exhaustedSize = 0;
+
+TEST_CASE("Realtime mode")
+{
+    RealtimeBudget budget(256 * 1024);
+
+    BlockAllocator ba(budget, 16 * 1024, [](size_t size) { exhaustedSize = size; });
+    FixedBlockAllocator<64> fba(budget);
+    LinearAllocator la(budget, 16 * 1024, 64);
+
+    // Size classes are set up before entering the realtime section
+    ba.Reserve(32, 100);
+
+    SetRealtimeViolationHandler([](size_t) { ++upstreamCalls; });
+    SetRealtimeThread(true);
+
+    void* a = ba.Allocate(32);
+    void* b = ba.Allocate(500);
+    void* c = fba.Allocate();
+    void* d = la.Allocate(1000);
+    REQUIRE_NE(a, nullptr);
+    REQUIRE_NE(b, nullptr);
+    REQUIRE_NE(c, nullptr);
+    REQUIRE_NE(d, nullptr);
+
+    // Fails instead of going upstream
+    REQUIRE_EQ(ba.Allocate(4096), nullptr);
+    REQUIRE_EQ(exhaustedSize, 4096);
+    REQUIRE_EQ(la.Reallocate(d, 1000, 32 * 1024), nullptr);
+
+    la.Free(d, 1000);
+    fba.Free(c);
+    ba.Free(b, 500);
+    ba.Free(a, 32);
+
+    // Carve chunks until the budget runs out
+    size_t count = 0;
+    while (fba.Allocate())
+    {
+        ++count;
+    }
+    REQUIRE_GT(count, 0);
+    REQUIRE_LT(budget.GetRemaining(), 64 + sizeof(Chunk) + alignof(Chunk));
+
+    // Clear keeps the chunks for reuse
+    size_t chunkCount = fba.GetChunkCount();
+    fba.Clear();
+    REQUIRE_NE(fba.Allocate(), nullptr);
+    REQUIRE_EQ(fba.GetChunkCount(), chunkCount);
+
+    ba.Clear();
+    REQUIRE_GE(ba.GetFreeCount(32), 100);
+
+#if !defined(SALLOC_HARDENED)
+    // Hardened builds keep free list guard metadata upstream
+    REQUIRE_EQ(upstreamCalls, 0);
+#endif
+
+#if defined(SALLOC_REALTIME_CHECKS)
+    size_t calls = upstreamCalls;
+    salloc::Free(salloc::Alloc(16));
+    REQUIRE_EQ(upstreamCalls, calls + 2);
+#endif
+
+    SetRealtimeThread(false);
+    SetRealtimeViolationHandler(nullptr);
+}
+
+TEST_CASE("Shared block allocator")
+{
+    SharedBlockAllocator sba(256 * 1024);
+
+    // Second mapping of the same region, as another process sees it
+    SharedBlockAllocator other(sba.GetHandle(), false);
+    REQUIRE_NE(other.GetPointer(0), sba.GetPointer(0));
+
+    int* a = (int*)sba.Allocate(sizeof(int));
+    *a = 42;
+    int* b = (int*)other.GetPointer(sba.GetOffset(a));
+    REQUIRE_EQ(*b, 42);
+
+    other.Free(b, sizeof(int));
+    REQUIRE_EQ(sba.GetBlockCount(), 0);
+    REQUIRE_EQ(sba.Allocate(sizeof(int)), a);
+
+    void* c = other.Allocate(100);
+    void* d = sba.Allocate(100);
+    REQUIRE_NE(sba.GetOffset(d), other.GetOffset(c));
+    REQUIRE_EQ(sba.GetChunkCount(), 2);
+
+#if defined(__linux__)
+    // Child process allocates from the same pool
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        SharedBlockAllocator child(sba.GetHandle(), false);
+        for (int i = 0; i < 100; ++i)
+        {
+            int* value = (int*)child.Allocate(sizeof(int));
+            *value = i;
+        }
+        _exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    REQUIRE_EQ(sba.GetBlockCount(), 103);
+#endif
+
+    // Fails once the region is full
+    while (sba.Allocate(1024))
+    {
+    }
+    REQUIRE_EQ(sba.Allocate(1024), nullptr);
+
+    sba.Clear();
+    REQUIRE_EQ(sba.GetBlockCount(), 0);
+    REQUIRE_EQ(sba.GetChunkCount(), 0);
+
+    // Chunk size is rounded up to the block unit, so later chunks stay aligned for the packed offsets
+    SharedBlockAllocator odd(size_t(256 * 1024), size_t(1027));
+    std::vector<void*> blocks;
+    for (int i = 0; i < 300; ++i)
+    {
+        blocks.push_back(odd.Allocate(8));
+        REQUIRE_EQ((uintptr_t)blocks.back() % SharedBlockAllocator::block_unit, 0);
+    }
+    REQUIRE_EQ(odd.GetChunkCount(), 3);
+
+    std::sort(blocks.begin(), blocks.end());
+    REQUIRE(std::adjacent_find(blocks.begin(), blocks.end()) == blocks.end());
+}
+
+TEST_CASE("Persistent fixed block allocator")
+{
+    struct Node
+    {
+        uint64_t value;
+        uint64_t next;
+    };
+
+    const char* path = "persistent_arena.bin";
+
+    {
+        PersistentFixedBlockAllocator<sizeof(Node)> arena(16 * 1024 * 1024, 16);
+
+        // Objects link each other by offset as well
+        uint64_t head = 0;
+        for (uint64_t i = 0; i < 100; ++i)
+        {
+            Node* node = (Node*)arena.Allocate();
+            node->value = i;
+            node->next = head;
+            head = arena.GetOffset(node);
+        }
+        arena.SetRoot(arena.GetPointer(head));
+
+        void* freed = arena.Allocate();
+        arena.Free(freed);
+
+        REQUIRE(arena.Save(path));
+    }
+
+    PersistentFixedBlockAllocator<sizeof(Node)> restored(16 * 1024 * 1024);
+    REQUIRE(restored.Load(path));
+    std::remove(path);
+
+    REQUIRE_EQ(restored.GetBlockCount(), 100);
+
+    uint64_t sum = 0;
+    Node* node = (Node*)restored.GetRoot();
+    while (node)
+    {
+        sum += node->value;
+        node = node->next ? (Node*)restored.GetPointer(node->next) : nullptr;
+    }
+    REQUIRE_EQ(sum, 4950);
+
+    // Free list carries over
+    size_t chunkCount = restored.GetChunkCount();
+    void* m = restored.Allocate();
+    REQUIRE_EQ(restored.GetChunkCount(), chunkCount);
+    restored.Free(m);
+
+    REQUIRE_FALSE(restored.Load("missing_arena.bin"));
+    REQUIRE_EQ(restored.GetBlockCount(), 100);
+
+    restored.Clear();
+    REQUIRE_EQ(restored.GetBlockCount(), 0);
+    REQUIRE_EQ(restored.GetRoot(), nullptr);
+}
+
+static thread_local size_t simulatedNode = 0;
+
+TEST_CASE("NUMA block allocator")
+{
+    // Two nodes simulated on a single node machine
+    NumaTopology topology{ 2, []() { return simulatedNode; }, false };
+
+    NumaBlockAllocator nba(topology, 16 * 1024, 1024 * 1024);
+    REQUIRE_EQ(nba.GetNodeCount(), 2);
+
+    simulatedNode = 0;
+    void* a = nba.Allocate(24);
+    REQUIRE_EQ(nba.GetNode(a), 0);
+
+    simulatedNode = 1;
+    void* b = nba.Allocate(24);
+    REQUIRE_EQ(nba.GetNode(b), 1);
+
+    // Freed on node 1, but returned to the node owning the chunk
+    nba.Free(a, 24);
+    void* c = nba.Allocate(24);
+    REQUIRE_EQ(nba.GetNode(c), 1);
+    REQUIRE_NE(c, a);
+
+    simulatedNode = 0;
+    REQUIRE_EQ(nba.Allocate(24), a);
+
+    REQUIRE_EQ(nba.GetBlockCount(), 3);
+    REQUIRE_EQ(nba.GetChunkCount(), 2);
+
+    NumaFixedBlockAllocator<16> nfba(topology, 64, 1024 * 1024);
+
+    simulatedNode = 1;
+    a = nfba.Allocate();
+    REQUIRE_EQ(nfba.GetNode(a), 1);
+
+    simulatedNode = 0;
+    nfba.Free(a);
+    REQUIRE_NE(nfba.Allocate(), a);
+
+    simulatedNode = 1;
+    REQUIRE_EQ(nfba.Allocate(), a);
+    REQUIRE_EQ(nfba.GetChunkCount(), 2);
+}
+
+TEST_CASE("Object pool")
+{
+    static int constructed = 0;
+    static int destroyed = 0;
+
+    struct Connection
+    {
+        int id = 0;
+        int buffer[16];
+
+        Connection()
+        {
+            ++constructed;
+        }
+
+        ~Connection()
+        {
+            ++destroyed;
+        }
+    };
+
+    ObjectPool<Connection> pool([](Connection& c) { c.id = 0; });
+
+    Connection* a = pool.Allocate();
+    Connection* b = pool.Allocate();
+    a->id = 1;
+    b->id = 2;
+
+    REQUIRE_EQ(constructed, 2);
+    REQUIRE_EQ(pool.GetCount(), 2);
+
+    int sum = 0;
+    pool.ForEach([&](Connection& c) { sum += c.id; });
+    REQUIRE_EQ(sum, 3);
+
+    // Freed objects stay constructed and get reset
+    pool.Free(a);
+    REQUIRE_EQ(destroyed, 0);
+
+    Connection* c = pool.Allocate();
+    REQUIRE_EQ(c, a);
+    REQUIRE_EQ(c->id, 0);
+    REQUIRE_EQ(constructed, 2);
+
+    pool.Clear();
+    REQUIRE_EQ(destroyed, 2);
+    REQUIRE_EQ(pool.GetChunkCount(), 0);
+}
+
+TEST_CASE("Handle pool")
+{
+    struct Entity
+    {
+        float x, y, z;
+    };
+
+    HandlePool<Entity, 16> pool;
+
+    Handle handles[40];
+    for (int i = 0; i < 40; i++)
+    {
+        handles[i] = pool.Create(float(i), 0.0f, 0.0f);
+    }
+
+    REQUIRE_EQ(pool.GetCount(), 40);
+    REQUIRE_EQ(pool.GetChunkCount(), 3);
+    REQUIRE_EQ(pool.Get(handles[7])->x, 7.0f);
+
+    pool.Destroy(handles[7]);
+    REQUIRE_FALSE(pool.IsValid(handles[7]));
+    REQUIRE_EQ(pool.Get(handles[7]), nullptr);
+
+    // Slot is reused with a new generation, the old handle stays stale
+    Handle h = pool.Create(100.0f, 0.0f, 0.0f);
+    REQUIRE_EQ(h.index, handles[7].index);
+    REQUIRE_NE(h.generation, handles[7].generation);
+    REQUIRE_FALSE(pool.IsValid(handles[7]));
+    REQUIRE(pool.IsValid(h));
+
+    REQUIRE_FALSE(pool.IsValid(Handle{}));
+    REQUIRE_FALSE(pool.IsValid(Handle{ 1000, 1 }));
+
+    // Live objects in memory order
+    float prev = -1.0f;
+    size_t visited = 0;
+    pool.ForEach([&](Entity& e) {
+        if (e.x != 100.0f)
+        {
+            REQUIRE_GT(e.x, prev);
+            prev = e.x;
+        }
+        ++visited;
+    });
+    REQUIRE_EQ(visited, 40);
+
+    pool.Clear();
+    REQUIRE_EQ(pool.GetCount(), 0);
+    REQUIRE_FALSE(pool.IsValid(h));
+
+    // Stale after Clear, even once the slot is reused
+    Handle reused = pool.Create(200.0f, 0.0f, 0.0f);
+    REQUIRE_EQ(reused.index, handles[0].index);
+    REQUIRE_FALSE(pool.IsValid(handles[0]));
+    REQUIRE_EQ(pool.Get(handles[0]), nullptr);
+    REQUIRE_EQ(pool.Get(reused)->x, 200.0f);
+    REQUIRE_EQ(pool.GetChunkCount(), 3);
+
+    // Slots of odd sized objects stay aligned for the free list index
+    struct Name
+    {
+        char c[5];
+    };
+
+    HandlePool<Name, 16> names;
+    REQUIRE_EQ(HandlePool<Name, 16>::block_size, 8);
+
+    Handle a = names.Create();
+    Handle b = names.Create();
+    REQUIRE_EQ((uintptr_t)names.Get(a) % alignof(uint32_t), 0);
+    REQUIRE_EQ((uintptr_t)names.Get(b) % alignof(uint32_t), 0);
+
+    names.Destroy(a);
+    REQUIRE(names.IsValid(b));
+}
+
+TEST_CASE("Thread block allocator")
+{
+    ThreadBlockAllocator owner;
+
+    void* blocks[100];
+    for (int i = 0; i < 100; i++)
+    {
+        blocks[i] = owner.Allocate(48);
+        REQUIRE_EQ(ThreadBlockAllocator::GetOwner(blocks[i]), &owner);
+    }
+
+    REQUIRE_EQ(owner.GetBlockCount(), 100);
+
+    // Free every block from a foreign thread through its own allocator
+    std::thread worker([&]() {
+        ThreadBlockAllocator local;
+        for (int i = 0; i < 100; i++)
+        {
+            local.Free(blocks[i], 48);
+        }
+        REQUIRE_EQ(local.GetSegmentCount(), 0);
+    });
+    worker.join();
+
+    // Not returned until the owner drains the remote free list
+    REQUIRE_EQ(owner.GetBlockCount(), 100);
+
+    owner.Collect();
+    REQUIRE_EQ(owner.GetBlockCount(), 0);
+
+    size_t segmentCount = owner.GetSegmentCount();
+    for (int i = 0; i < 100; i++)
+    {
+        blocks[i] = owner.Allocate(48);
+    }
+    REQUIRE_EQ(owner.GetSegmentCount(), segmentCount);
+
+    for (int i = 0; i < 100; i++)
+    {
+        owner.Free(blocks[i], 48);
+    }
+
+    // The owning thread exits while its blocks are still out, the last free releases the segments
+    std::vector<void*> orphans;
+    std::thread producer([&]() {
+        ThreadBlockAllocator local;
+        for (int i = 0; i < 2000; i++)
+        {
+            orphans.push_back(local.Allocate(64));
+        }
+        local.Free(orphans[0], 64);
+        owner.Free(orphans[1], 64);
+    });
+    producer.join();
+
+    REQUIRE_EQ(ThreadBlockAllocator::GetOwner(orphans[2]), nullptr);
+    for (size_t i = 2; i < orphans.size(); i++)
+    {
+        owner.Free(orphans[i], 64);
+    }
+    REQUIRE_EQ(owner.GetSegmentCount(), segmentCount);
+}
+
+TEST_CASE("Ring allocator")
+{
+    RingAllocator ra{ 64 * 1024 };
+    size_t capacity = ra.GetCapacity();
+    REQUIRE_GE(capacity, 64 * 1024);
+
+    char* a = (char*)ra.Allocate(capacity / 2);
+    char* b = (char*)ra.Allocate(capacity / 4);
+    REQUIRE_EQ(b, a + capacity / 2 + 8);
+    REQUIRE_EQ(ra.Allocate(capacity / 2), nullptr);
+
+    // Freed out of order, nothing is reclaimed until the oldest record goes
+    ra.Free(b, capacity / 4);
+    REQUIRE_EQ(ra.GetUsedSize(), capacity * 3 / 4 + 16);
+    ra.Free(a, capacity / 2);
+    REQUIRE_EQ(ra.GetUsedSize(), 0);
+
+    // Crosses the end of the ring and stays contiguous, the wrapped part lands at the start
+    char* c = (char*)ra.Allocate(capacity / 2);
+    REQUIRE_EQ(c, b + capacity / 4 + 8);
+    memset(c, 3, capacity / 2);
+    sallocUnpoison(a, 1);
+    REQUIRE_EQ(a[0], 3);
+    sallocPoison(a, 1);
+    ra.Free(c, capacity / 2);
+
+    // One producer and one consumer thread
+    constexpr size_t count = 10000;
+    std::vector<std::atomic<uint32_t*>> records(count);
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            size_t size = sizeof(uint32_t) * (1 + i % 64);
+            uint32_t* p;
+            while ((p = (uint32_t*)ra.Allocate(size)) == nullptr)
+            {
+                std::this_thread::yield();
+            }
+            p[0] = i;
+            p[size / sizeof(uint32_t) - 1] = i;
+            records[i].store(p, std::memory_order_release);
+        }
+    });
+
+    bool ordered = true;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t* p;
+        while ((p = records[i].load(std::memory_order_acquire)) == nullptr)
+        {
+            std::this_thread::yield();
+        }
+        size_t size = sizeof(uint32_t) * (1 + i % 64);
+        ordered &= p[0] == i && p[size / sizeof(uint32_t) - 1] == i;
+        ra.Free(p, size);
+    }
+    producer.join();
+
+    REQUIRE(ordered);
+    REQUIRE_EQ(ra.GetUsedSize(), 0);
+}
+
+#if defined(SALLOC_HARDENED)
+TEST_CASE("Hardened free lists")
+{
+    FixedBlockAllocator<32> fba;
+
+    // Free list order within a chunk is randomized
+    char* prev = (char*)fba.Allocate();
+    bool sequential = true;
+    for (int i = 0; i < 32; i++)
+    {
+        char* next = (char*)fba.Allocate();
+        sequential &= (next == prev + 32);
+        prev = next;
+    }
+    REQUIRE_FALSE(sequential);
+
+    // Next pointers are not stored in plain form
+    void* a = fba.Allocate();
+    void* b = fba.Allocate();
+    fba.Free(a);
+    fba.Free(b);
+    sallocUnpoison(b, sizeof(void*));
+    REQUIRE_NE(*(void**)b, a);
+
+    REQUIRE_EQ(fba.Allocate(), b);
+    REQUIRE_EQ(fba.Allocate(), a);
+
+#if defined(__linux__)
+    // Double frees and foreign pointers abort
+    void* c = fba.Allocate();
+    fba.Free(c);
+    REQUIRE(Aborts([&]() { fba.Free(c); }));
+
+    alignas(32) char foreign[32];
+    REQUIRE(Aborts([&]() { fba.Free(foreign); }));
+
+    BlockAllocator ba;
+    void* d = ba.Allocate(100);
+    ba.Free(d, 100);
+    REQUIRE(Aborts([&]() { ba.Free(d, 100); }));
+    REQUIRE(Aborts([&]() { ba.Free(foreign, 32); }));
+#endif
+}
+#endif
+
+#if defined(SALLOC_ASAN)
+TEST_CASE("Poisoned free blocks")
+{
+    BlockAllocator ba;
+
+    char* m = (char*)ba.Allocate(20);
+    REQUIRE_FALSE(__asan_address_is_poisoned(m + 19));
+
+    // Slack up to the block size is poisoned
+    REQUIRE(__asan_address_is_poisoned(m + 20));
+
+    ba.Free(m, 20);
+    REQUIRE(__asan_address_is_poisoned(m));
+
+    LinearAllocator la;
+
+    char* a = (char*)la.Allocate(32);
+    char* b = (char*)la.Allocate(32);
+    REQUIRE(__asan_address_is_poisoned(a + 32)); // Redzone
+    REQUIRE_FALSE(__asan_address_is_poisoned(b));
+
+    la.Free(b, 32);
+    REQUIRE(__asan_address_is_poisoned(b));
+
+    la.Free(a, 32);
+}
+#endif
+
+TEST_CASE("Instrumentation")
+{
+    SUBCASE("Histogram")
+    {
+        // Exact below 8, then 8 buckets per power of two
+        REQUIRE_EQ(Histogram::GetBucket(0), 0);
+        REQUIRE_EQ(Histogram::GetBucket(7), 7);
+        REQUIRE_EQ(Histogram::GetBucket(8), 8);
+        REQUIRE_EQ(Histogram::GetBucket(15), 15);
+        REQUIRE_EQ(Histogram::GetBucket(16), 16);
+        REQUIRE_EQ(Histogram::GetBucket(17), 16);
+        REQUIRE_EQ(Histogram::GetBucket(UINT64_MAX), Histogram::bucket_count - 1);
+
+        REQUIRE_EQ(Histogram::GetBucketBound(16), 17);
+        REQUIRE_EQ(Histogram::GetBucketBound(Histogram::bucket_count - 1), UINT64_MAX);
+
+        for (uint64_t value : { 1ull, 100ull, 1000ull, 123456789ull, 1ull << 40 })
+        {
+            size_t bucket = Histogram::GetBucket(value);
+            REQUIRE_LE(value, Histogram::GetBucketBound(bucket));
+            REQUIRE_GT(value, Histogram::GetBucketBound(bucket - 1));
+        }
+
+        Histogram* histogram = new Histogram{};
+        REQUIRE_EQ(histogram->GetPercentile(50), 0);
+
+        for (uint64_t i = 1; i <= 1000; i++)
+        {
+            histogram->Record(i);
+        }
+        REQUIRE_EQ(histogram->count.load(), 1000);
+        REQUIRE_EQ(histogram->sum.load(), 500500);
+
+        // Within a bucket width of the exact value
+        uint64_t median = histogram->GetPercentile(50);
+        REQUIRE_GE(median, 500);
+        REQUIRE_LE(median, 500 + 500 / 8);
+        REQUIRE_GE(histogram->GetPercentile(99), 990);
+        REQUIRE_EQ(histogram->GetPercentile(100), Histogram::GetBucketBound(Histogram::GetBucket(1000)));
+
+        delete histogram;
+    }
+
+#if defined(SALLOC_INSTRUMENT)
+    SUBCASE("Export")
+    {
+        ResetInstrumentation();
+
+        BlockAllocator ba;
+        void* a = ba.Allocate(20);
+        void* b = ba.Allocate(20);
+        ba.Free(a, 20);
+        ba.Free(b, 20);
+        ba.Clear();
+
+        FixedBlockAllocator<48> fba;
+        void* c = fba.Allocate();
+        void* d = fba.Allocate();
+        void* e = fba.Allocate();
+        fba.Free(c);
+        fba.Free(d);
+        fba.Free(e);
+
+        StaticPredefinedBlockAllocator<16, 64> spba;
+        void* f = spba.Allocate(64);
+        void* g = spba.Allocate(64);
+        spba.Free(f, 64);
+        spba.Free(g, 64);
+        spba.Clear();
+
+        uint64_t counts[instrument_event_count] = {};
+        ExportInstrumentation(
+            [](const InstrumentRecord& record, void* userData) {
+                ((uint64_t*)userData)[(size_t)record.event] += record.histogram.count.load();
+            },
+            counts
+        );
+
+        REQUIRE_EQ(counts[(size_t)InstrumentEvent::refill], 3);
+        REQUIRE_EQ(counts[(size_t)InstrumentEvent::free_list_pop], 4);
+        REQUIRE_EQ(counts[(size_t)InstrumentEvent::clear], 2);
+        REQUIRE_EQ(GetInstrumentHistogram(InstrumentEvent::free_list_pop, 48).count.load(), 2);
+        REQUIRE_EQ(GetInstrumentHistogram(InstrumentEvent::free_list_pop, 64).count.load(), 1);
+        REQUIRE_GE(counts[(size_t)InstrumentEvent::upstream_alloc], 1);
+        REQUIRE_GT(GetTickFrequency(), 0.0);
+
+        ResetInstrumentation();
+        ExportInstrumentation([](const InstrumentRecord&, void*) { FAIL("Nothing recorded after reset"); });
+    }
+#endif
+}